@@ -0,0 +1,47 @@
+/***************************************************************************
+ * btree_journal.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Dead-End
+ **************************************************************************/
+
+#ifndef BTREE_JOURNAL_H_
+#define BTREE_JOURNAL_H_
+
+#include <stddef.h>
+
+#include "btree_properties.h"
+
+//
+// The record types of the journal.
+//
+#define BTP_JOURNAL_ADD     'A'
+#define BTP_JOURNAL_REPLACE 'R'
+#define BTP_JOURNAL_DELETE  'D'
+
+//
+// Default number of records that are written with a single fsync and the
+// default journal size, which triggers a compaction.
+//
+#define BTP_JOURNAL_SYNC_BATCH 32
+#define BTP_JOURNAL_COMPACT_SIZE (1024 * 1024)
+
+/***************************************************************************
+ * The journal is an append-only file with the changes of a context. It is
+ * attached to the context and records all changes, that are made with
+ * btp_add_property and btp_delete_property.
+ **************************************************************************/
+
+typedef struct BTP_journal BTP_journal;
+
+BTP_journal *btp_journal_open(BTP_ctx *ctx, const char *path, const int sync_batch, const size_t compact_size);
+
+void btp_journal_sync(BTP_journal *journal);
+
+void btp_journal_close(BTP_journal *journal);
+
+void btp_journal_append(BTP_journal *journal, const char type, const char *key, const char *value);
+
+void btp_journal_walk(const BTP_ctx *ctx, void (*callback)(const char *key, const char *value));
+
+#endif /* BTREE_JOURNAL_H_ */
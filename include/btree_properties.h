@@ -9,16 +9,101 @@
 #define BTREE_PROPERTIES_H_
 
 #include <stdbool.h>
+#include <stddef.h>
+
+/***************************************************************************
+ * The type of a difference between two contexts, which is reported by
+ * btp_diff. Added keys are only in the second, removed keys only in the
+ * first context.
+ **************************************************************************/
+
+typedef enum BTP_diff_type {
+	BTP_DIFF_ADDED, BTP_DIFF_REMOVED, BTP_DIFF_CHANGED
+} BTP_diff_type;
+
+/***************************************************************************
+ * The policy of btp_merge for keys that exist in both contexts. KEEP keeps
+ * the value of the destination, REPLACE takes the value of the source and
+ * MIRROR additionally deletes the keys that are not in the source.
+ **************************************************************************/
+
+typedef enum BTP_merge_policy {
+	BTP_MERGE_KEEP, BTP_MERGE_REPLACE, BTP_MERGE_MIRROR
+} BTP_merge_policy;
+
+/***************************************************************************
+ * The error codes of the functions, that report errors instead of exiting.
+ **************************************************************************/
+
+typedef enum BTP_error_code {
+	BTP_ERROR_NONE,
+	BTP_ERROR_ARGUMENT,
+	BTP_ERROR_MEMORY,
+	BTP_ERROR_OPEN,
+	BTP_ERROR_READ,
+	BTP_ERROR_SYNTAX,
+	BTP_ERROR_FILE_SIZE,
+	BTP_ERROR_LINE_LENGTH,
+	BTP_ERROR_NUM_KEYS
+} BTP_error_code;
+
+#define BTP_ERROR_REASON 256
+
+/***************************************************************************
+ * The error report with the file and the line, if the error is related to
+ * a file, and a readable reason.
+ **************************************************************************/
+
+typedef struct BTP_error {
+	BTP_error_code code;
+	const char *file;
+	int line;
+	char reason[BTP_ERROR_REASON];
+} BTP_error;
+
+/***************************************************************************
+ * The limits for reading a properties file from an untrusted source. A
+ * limit of 0 is unlimited, except for the line length, where 0 is the
+ * default.
+ **************************************************************************/
+
+typedef struct BTP_limits {
+	long max_file_size;
+	int max_line_len;
+	int max_keys;
+} BTP_limits;
+
+/***************************************************************************
+ * The memory that is used by a context. The nodes are the nodes of the
+ * btree, the keys and values are the bytes of the strings and the overhead
+ * contains the context, the entry structs, unused value buffers and the
+ * unused bytes of the allocations.
+ **************************************************************************/
+
+typedef struct BTP_memory {
+	size_t nodes;
+	size_t keys;
+	size_t values;
+	size_t overhead;
+	size_t total;
+} BTP_memory;
 
 /***************************************************************************
  * The struct is a simple wrapper around the pointer 'void *root'. The btree
  * api uses 'void *root' and 'void **rootp' pointers. The use is error
- * prone, because the wrong pointer does not lead to compiler warnings.
+ * prone, because the wrong pointer does not lead to compiler warnings. The
+ * generation is renewed on each change of the entries. A running
+ * compaction is stored in the context until it is finished. The arena
+ * contains the entries, that were moved by a compaction.
  **************************************************************************/
 
 typedef struct BTP_ctx {
 	void *root;
 	int num_entries;
+	unsigned long generation;
+	struct BTP_journal *journal;
+	struct BTP_compaction *compaction;
+	struct BTP_arena *arena;
 } BTP_ctx;
 
 BTP_ctx *btp_create_ctx();
@@ -31,12 +116,35 @@ char *btp_get_property_value(const BTP_ctx *ctx, char *key);
 
 bool btp_add_property(BTP_ctx *ctx, char *key, const char *value, const bool replace);
 
+bool btp_try_add_property(BTP_ctx *ctx, char *key, const char *value, const bool replace, bool *added, BTP_error *error);
+
 void btp_read_properties(BTP_ctx *ctx, const char *filename);
 
+bool btp_try_read_properties(BTP_ctx *ctx, const char *filename, const BTP_limits *limits, BTP_error *error);
+
+bool btp_try_parse_property(BTP_ctx *ctx, char *line, BTP_error *error);
+
 void btp_iterate_properties(const BTP_ctx *ctx, void (*callback)(const char *key, const char *value));
 
 bool btp_delete_property(BTP_ctx *ctx, char *key);
 
+void btp_diff(const BTP_ctx *ctx_a, const BTP_ctx *ctx_b, void (*callback)(const BTP_diff_type type, const char *key, const char *value_a, const char *value_b));
+
+int btp_merge(BTP_ctx *dst, const BTP_ctx *src, const BTP_merge_policy policy);
+
+BTP_memory btp_memory_usage(const BTP_ctx *ctx);
+
+bool btp_compact(BTP_ctx *ctx, const int max_steps);
+
 #define DEBUG
 
+//
+// The per thread lookup cache of btp_get_property_value is enabled by
+// compiling with -DBTP_LOOKUP_CACHE. The number of lines has to be a power
+// of two.
+//
+#ifndef BTP_LOOKUP_CACHE_SIZE
+#define BTP_LOOKUP_CACHE_SIZE 64
+#endif
+
 #endif /* BTREE_PROPERTIES_H_ */
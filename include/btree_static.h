@@ -0,0 +1,38 @@
+/***************************************************************************
+ * btree_static.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Dead-End
+ **************************************************************************/
+
+#ifndef BTREE_STATIC_H_
+#define BTREE_STATIC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/***************************************************************************
+ * A read-only context, which is generated by btree_codegen from a
+ * properties file. The keys and values are stored in a string pool and are
+ * found with a minimal perfect hash. The displacement of a bucket is the
+ * seed of the second hash, or -(slot + 1) for a bucket with a single key.
+ **************************************************************************/
+
+typedef struct BTP_static_ctx {
+	int num_entries;
+	const char *pool;
+	const uint32_t *key_offsets;
+	const uint32_t *key_lens;
+	const uint32_t *value_offsets;
+	const int32_t *displacements;
+} BTP_static_ctx;
+
+uint32_t btp_static_hash(const uint32_t seed, const char *key, const size_t len);
+
+int btp_static_get_num_entries(const BTP_static_ctx *ctx);
+
+const char *btp_static_get_property_value(const BTP_static_ctx *ctx, const char *key);
+
+void btp_static_iterate_properties(const BTP_static_ctx *ctx, void (*callback)(const char *key, const char *value));
+
+#endif /* BTREE_STATIC_H_ */
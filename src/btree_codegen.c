@@ -0,0 +1,402 @@
+/***************************************************************************
+ * btree_codegen.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Dead-End
+ **************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+
+#include "btree_properties.h"
+#include "btree_static.h"
+
+//
+// The maximum seed, that is tried for a bucket, before the generator gives
+// up.
+//
+#define MAX_SEED (1 << 24)
+
+/***************************************************************************
+ * A key / value pair of the properties file with the length of the key and
+ * its bucket of the first hash.
+ **************************************************************************/
+
+typedef struct Pair {
+	const char *key;
+	const char *value;
+	size_t key_len;
+	uint32_t bucket;
+} Pair;
+
+//
+// The pairs, which are filled by the collector callback.
+//
+static Pair *stored_pairs;
+static int stored_num;
+
+/***************************************************************************
+ * The function is a callback for the iterator. It adds the key / value pair
+ * to the stored pairs.
+ **************************************************************************/
+
+static void collect_pair(const char *key, const char *value) {
+	Pair *pair = &stored_pairs[stored_num++];
+
+	pair->key = key;
+	pair->value = value;
+	pair->key_len = strlen(key);
+}
+
+/***************************************************************************
+ * The function allocates zeroed memory or exits.
+ **************************************************************************/
+
+static void *allocate(const size_t num, const size_t size) {
+	void *ptr = calloc(num == 0 ? 1 : num, size);
+
+	if (ptr == NULL) {
+		fprintf(stderr, "allocate() Unable allocate memory!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	return ptr;
+}
+
+/***************************************************************************
+ * The function computes the minimal perfect hash with the hash and
+ * displace algorithm. The keys are distributed to buckets by the first
+ * hash. Starting with the largest bucket, a seed is searched for each
+ * bucket, which maps all its keys to free slots. A bucket with a single
+ * key takes the next free slot directly. The function fills the
+ * displacements and the slots, which contains the index of the pair for
+ * each slot.
+ **************************************************************************/
+
+static void compute_hash(const Pair *pairs, const int num, int32_t *displacements, int *slots) {
+	int *bucket_sizes = allocate(num, sizeof(int));
+	int *bucket_starts = allocate(num + 1, sizeof(int));
+	int *bucket_pairs = allocate(num, sizeof(int));
+	int *order = allocate(num, sizeof(int));
+	uint32_t *candidates = allocate(num, sizeof(uint32_t));
+
+	for (int i = 0; i < num; i++) {
+		slots[i] = -1;
+		bucket_sizes[pairs[i].bucket]++;
+	}
+
+	//
+	// sort the pairs by bucket (counting sort)
+	//
+	for (int b = 0; b < num; b++) {
+		bucket_starts[b + 1] = bucket_starts[b] + bucket_sizes[b];
+	}
+
+	int *fill = allocate(num, sizeof(int));
+	for (int i = 0; i < num; i++) {
+		const uint32_t b = pairs[i].bucket;
+		bucket_pairs[bucket_starts[b] + fill[b]++] = i;
+	}
+	free(fill);
+
+	//
+	// sort the non empty buckets by size in descending order (counting sort)
+	//
+	int *size_starts = allocate(num + 2, sizeof(int));
+
+	for (int b = 0; b < num; b++) {
+		size_starts[num - bucket_sizes[b] + 1]++;
+	}
+
+	for (int i = 0; i <= num; i++) {
+		size_starts[i + 1] += size_starts[i];
+	}
+
+	int pos = 0;
+	for (int b = 0; b < num; b++) {
+		if (bucket_sizes[b] > 0) {
+			order[size_starts[num - bucket_sizes[b]]++] = b;
+			pos++;
+		}
+	}
+	free(size_starts);
+
+	int free_slot = 0;
+
+	for (int o = 0; o < pos; o++) {
+		const int b = order[o];
+		const int size = bucket_sizes[b];
+		const int *members = bucket_pairs + bucket_starts[b];
+
+		//
+		// a single key takes the next free slot
+		//
+		if (size == 1) {
+			while (slots[free_slot] != -1) {
+				free_slot++;
+			}
+			slots[free_slot] = members[0];
+			displacements[b] = -free_slot - 1;
+			continue;
+		}
+
+		//
+		// search a seed that maps all keys of the bucket to different free slots
+		//
+		uint32_t seed;
+		for (seed = 1; seed < MAX_SEED; seed++) {
+			bool found = true;
+
+			for (int m = 0; m < size && found; m++) {
+				const Pair *pair = &pairs[members[m]];
+				candidates[m] = btp_static_hash(seed, pair->key, pair->key_len) % num;
+
+				if (slots[candidates[m]] != -1) {
+					found = false;
+				}
+
+				for (int k = 0; k < m && found; k++) {
+					if (candidates[k] == candidates[m]) {
+						found = false;
+					}
+				}
+			}
+
+			if (found) {
+				break;
+			}
+		}
+
+		if (seed == MAX_SEED) {
+			fprintf(stderr, "compute_hash() Unable to find a seed for bucket: %d\n", b);
+			exit(EXIT_FAILURE);
+		}
+
+		for (int m = 0; m < size; m++) {
+			slots[candidates[m]] = members[m];
+		}
+		displacements[b] = seed;
+	}
+
+	free(bucket_sizes);
+	free(bucket_starts);
+	free(bucket_pairs);
+	free(order);
+	free(candidates);
+}
+
+/***************************************************************************
+ * The function writes a string as a C string literal. All non printable
+ * chars, quotes and backslashes are written as octal escapes with three
+ * digits, so a following digit is not part of the escape.
+ **************************************************************************/
+
+static void write_literal(FILE *file, const char *str) {
+
+	for (const char *c = str; *c; c++) {
+		const unsigned char uc = (unsigned char) *c;
+
+		if (isprint(uc) && uc != '"' && uc != '\\' && uc != '?') {
+			fputc(uc, file);
+		} else {
+			fprintf(file, "\\%03o", uc);
+		}
+	}
+}
+
+/***************************************************************************
+ * The function opens an output file or exits.
+ **************************************************************************/
+
+static FILE *open_output(const char *prefix, const char *suffix, char *path, const size_t size) {
+	snprintf(path, size, "%s%s", prefix, suffix);
+
+	FILE *file = fopen(path, "w");
+	if (file == NULL) {
+		fprintf(stderr, "open_output() Unable to open file: %s! Error: %s\n", path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	return file;
+}
+
+/***************************************************************************
+ * The function writes the header file, which declares the context.
+ **************************************************************************/
+
+static void write_header(const char *prefix, const char *name) {
+	char path[FILENAME_MAX];
+	FILE *file = open_output(prefix, ".h", path, sizeof(path));
+
+	fprintf(file, "/* Generated by btree_codegen. Do not edit. */\n\n");
+	fprintf(file, "#ifndef BTP_STATIC_%s_H_\n", name);
+	fprintf(file, "#define BTP_STATIC_%s_H_\n\n", name);
+	fprintf(file, "#include \"btree_static.h\"\n\n");
+	fprintf(file, "extern const BTP_static_ctx %s;\n\n", name);
+	fprintf(file, "#endif /* BTP_STATIC_%s_H_ */\n", name);
+
+	fclose(file);
+}
+
+/***************************************************************************
+ * The function writes a uint32 or int32 array.
+ **************************************************************************/
+
+static void write_array(FILE *file, const char *type, const char *name, const char *suffix, const int64_t *values, const int num) {
+	fprintf(file, "static const %s %s_%s[%d] = {", type, name, suffix, num == 0 ? 1 : num);
+
+	for (int i = 0; i < num; i++) {
+		fprintf(file, "%s%s%lld", i == 0 ? "" : ",", i % 8 == 0 ? "\n\t" : " ", (long long) values[i]);
+	}
+
+	fprintf(file, num == 0 ? "0 };\n\n" : "\n};\n\n");
+}
+
+/***************************************************************************
+ * The function writes the source file with the string pool, the offset and
+ * displacement arrays and the context.
+ **************************************************************************/
+
+static void write_source(const char *prefix, const char *name, const Pair *pairs, const int num, const int32_t *displacements, const int *slots) {
+	char path[FILENAME_MAX];
+	FILE *file = open_output(prefix, ".c", path, sizeof(path));
+	int64_t *key_offsets = allocate(num, sizeof(int64_t));
+	int64_t *key_lens = allocate(num, sizeof(int64_t));
+	int64_t *value_offsets = allocate(num, sizeof(int64_t));
+	int64_t *values = allocate(num, sizeof(int64_t));
+
+	const char *base = strrchr(prefix, '/');
+	base = base == NULL ? prefix : base + 1;
+
+	fprintf(file, "/* Generated by btree_codegen. Do not edit. */\n\n");
+	fprintf(file, "#include \"%s.h\"\n\n", base);
+
+	//
+	// the pool contains the keys and values in the order of the slots
+	//
+	fprintf(file, "static const char %s_pool[] =", name);
+
+	int64_t offset = 0;
+	for (int slot = 0; slot < num; slot++) {
+		const Pair *pair = &pairs[slots[slot]];
+
+		key_offsets[slot] = offset;
+		key_lens[slot] = pair->key_len;
+		offset += pair->key_len + 1;
+
+		value_offsets[slot] = offset;
+		offset += strlen(pair->value) + 1;
+
+		fprintf(file, "\n\t\"");
+		write_literal(file, pair->key);
+		fprintf(file, "\\000");
+		write_literal(file, pair->value);
+		fprintf(file, "\\000\"");
+	}
+
+	fprintf(file, num == 0 ? " \"\";\n\n" : ";\n\n");
+
+	write_array(file, "uint32_t", name, "key_offsets", key_offsets, num);
+	write_array(file, "uint32_t", name, "key_lens", key_lens, num);
+	write_array(file, "uint32_t", name, "value_offsets", value_offsets, num);
+
+	for (int b = 0; b < num; b++) {
+		values[b] = displacements[b];
+	}
+	write_array(file, "int32_t", name, "displacements", values, num);
+
+	fprintf(file, "const BTP_static_ctx %s = {\n", name);
+	fprintf(file, "\t%d,\n", num);
+	fprintf(file, "\t%s_pool,\n", name);
+	fprintf(file, "\t%s_key_offsets,\n", name);
+	fprintf(file, "\t%s_key_lens,\n", name);
+	fprintf(file, "\t%s_value_offsets,\n", name);
+	fprintf(file, "\t%s_displacements\n", name);
+	fprintf(file, "};\n");
+
+	fclose(file);
+
+	free(key_offsets);
+	free(key_lens);
+	free(value_offsets);
+	free(values);
+}
+
+/***************************************************************************
+ * The function checks that the name is a valid C identifier.
+ **************************************************************************/
+
+static bool is_identifier(const char *name) {
+
+	if (!isalpha((unsigned char) *name) && *name != '_') {
+		return false;
+	}
+
+	for (const char *c = name; *c; c++) {
+		if (!isalnum((unsigned char) *c) && *c != '_') {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/***************************************************************************
+ * The generator reads a properties file and writes a C source and header
+ * file with a static context. Usage:
+ *
+ * btree_codegen <props-file> <output-prefix> <name>
+ **************************************************************************/
+
+int main(int argc, char *argv[]) {
+
+	if (argc != 4) {
+		fprintf(stderr, "Usage: %s <props-file> <output-prefix> <name>\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	const char *props = argv[1];
+	const char *prefix = argv[2];
+	const char *name = argv[3];
+
+	if (!is_identifier(name)) {
+		fprintf(stderr, "main() Name: '%s' is not a valid identifier!\n", name);
+		return EXIT_FAILURE;
+	}
+
+	BTP_ctx *ctx = btp_create_ctx();
+	btp_read_properties(ctx, props);
+
+	const int num = btp_get_num_entries(ctx);
+	Pair *pairs = allocate(num, sizeof(Pair));
+
+	stored_pairs = pairs;
+	stored_num = 0;
+	btp_iterate_properties(ctx, collect_pair);
+	stored_pairs = NULL;
+
+	for (int i = 0; i < num; i++) {
+		pairs[i].bucket = btp_static_hash(0, pairs[i].key, pairs[i].key_len) % num;
+	}
+
+	int32_t *displacements = allocate(num, sizeof(int32_t));
+	int *slots = allocate(num, sizeof(int));
+
+	compute_hash(pairs, num, displacements, slots);
+
+	write_header(prefix, name);
+	write_source(prefix, name, pairs, num, displacements, slots);
+
+	printf("btree_codegen() Written: %s.c and %s.h with entries: %d\n", prefix, prefix, num);
+
+	free(displacements);
+	free(slots);
+	free(pairs);
+	btp_destroy_ctx(ctx);
+
+	return EXIT_SUCCESS;
+}
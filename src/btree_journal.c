@@ -0,0 +1,690 @@
+/***************************************************************************
+ * btree_journal.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Dead-End
+ **************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "btree_properties.h"
+#include "btree_journal.h"
+
+//
+// Definition of the print_debug macro.
+//
+#ifdef DEBUG
+#define DEBUG_OUT stdout
+#define print_debug(fmt, ...) fprintf(DEBUG_OUT, "DEBUG - " fmt, ##__VA_ARGS__)
+#else
+#define print_debug(fmt, ...)
+#endif
+
+//
+// Each journal and base file starts with the magic string.
+//
+#define MAGIC "BTPJ0001"
+#define MAGIC_LEN 8
+
+//
+// A record consists of the type, the key length, the value length, the key
+// and the value (both terminated with '\0') and a checksum.
+//
+#define RECORD_HEADER (1 + 2 * sizeof(uint32_t))
+#define RECORD_SIZE(key_len, value_len) (RECORD_HEADER + (key_len) + 1 + (value_len) + 1 + sizeof(uint32_t))
+
+/***************************************************************************
+ * A simple growing byte buffer, which is used to collect records.
+ **************************************************************************/
+
+typedef struct Buffer {
+	char *data;
+	size_t len;
+	size_t size;
+} Buffer;
+
+/***************************************************************************
+ * The journal with its files. The records are collected in the buffer and
+ * written with a single write and fsync, if the batch is full.
+ **************************************************************************/
+
+struct BTP_journal {
+	BTP_ctx *ctx;
+
+	char *path;
+	char *base_path;
+	char *prev_path;
+	char *tmp_path;
+	char *dir_path;
+
+	int fd;
+	size_t size;
+	Buffer buffer;
+	int pending;
+
+	int sync_batch;
+	size_t compact_size;
+
+	//
+	// The compaction thread writes the snapshot to the base file.
+	//
+	pthread_t compactor;
+	bool compacting;
+	atomic_bool compacted;
+};
+
+//
+// The buffer, which is filled by the snapshot callback of the journal walk.
+// The compaction thread and the caller of btp_journal_open can create
+// snapshots at the same time, so each thread has its own buffer.
+//
+static __thread Buffer *stored_snapshot;
+
+/***************************************************************************
+ * The function computes the FNV-1a hash of the bytes, which is used as a
+ * checksum of the records.
+ **************************************************************************/
+
+static uint32_t checksum(const char *data, const size_t len) {
+	uint32_t hash = 2166136261u;
+
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (unsigned char) data[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/***************************************************************************
+ * The function ensures that the buffer has space for a given number of
+ * additional bytes.
+ **************************************************************************/
+
+static void buffer_reserve(Buffer *buffer, const size_t len) {
+
+	if (buffer->len + len <= buffer->size) {
+		return;
+	}
+
+	size_t size = buffer->size == 0 ? 4096 : buffer->size;
+	while (size < buffer->len + len) {
+		size *= 2;
+	}
+
+	buffer->data = realloc(buffer->data, size);
+	if (buffer->data == NULL) {
+		fprintf(stderr, "buffer_reserve() Unable allocate memory!\n");
+		exit(EXIT_FAILURE);
+	}
+	buffer->size = size;
+}
+
+/***************************************************************************
+ * The function appends a record to the buffer.
+ **************************************************************************/
+
+static void buffer_append_record(Buffer *buffer, const char type, const char *key, const char *value) {
+	const uint32_t key_len = strlen(key);
+	const uint32_t value_len = strlen(value);
+
+	buffer_reserve(buffer, RECORD_SIZE(key_len, value_len));
+
+	char *record = buffer->data + buffer->len;
+	char *ptr = record;
+
+	*ptr++ = type;
+	memcpy(ptr, &key_len, sizeof(uint32_t));
+	ptr += sizeof(uint32_t);
+	memcpy(ptr, &value_len, sizeof(uint32_t));
+	ptr += sizeof(uint32_t);
+	memcpy(ptr, key, key_len + 1);
+	ptr += key_len + 1;
+	memcpy(ptr, value, value_len + 1);
+	ptr += value_len + 1;
+
+	const uint32_t sum = checksum(record, ptr - record);
+	memcpy(ptr, &sum, sizeof(uint32_t));
+	ptr += sizeof(uint32_t);
+
+	buffer->len += ptr - record;
+}
+
+/***************************************************************************
+ * The function writes all bytes to the file descriptor.
+ **************************************************************************/
+
+static void write_all(const int fd, const char *data, size_t len, const char *path) {
+
+	while (len > 0) {
+		const ssize_t written = write(fd, data, len);
+
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			fprintf(stderr, "write_all() Unable to write file: %s! Error: %s\n", path, strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+
+		data += written;
+		len -= written;
+	}
+}
+
+/***************************************************************************
+ * The function syncs the file descriptor to the disk.
+ **************************************************************************/
+
+static void sync_fd(const int fd, const char *path) {
+
+	if (fsync(fd) != 0) {
+		fprintf(stderr, "sync_fd() Unable to sync file: %s! Error: %s\n", path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+}
+
+/***************************************************************************
+ * The function syncs a directory, so a created, renamed or removed file
+ * in the directory is durable.
+ **************************************************************************/
+
+static void sync_dir(const char *path) {
+	const int fd = open(path, O_RDONLY | O_DIRECTORY);
+
+	if (fd < 0) {
+		fprintf(stderr, "sync_dir() Unable to open directory: %s! Error: %s\n", path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	sync_fd(fd, path);
+	close(fd);
+}
+
+/***************************************************************************
+ * The function creates a path from a prefix and a suffix.
+ **************************************************************************/
+
+static char *create_path(const char *path, const char *suffix) {
+	const size_t len = strlen(path) + strlen(suffix) + 1;
+	char *result = malloc(len);
+
+	if (result == NULL) {
+		fprintf(stderr, "create_path() Unable allocate memory!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	snprintf(result, len, "%s%s", path, suffix);
+	return result;
+}
+
+/***************************************************************************
+ * The function creates the path of the directory, which contains a file.
+ **************************************************************************/
+
+static char *create_dir_path(const char *path) {
+	const char *slash = strrchr(path, '/');
+
+	if (slash == NULL) {
+		return create_path(".", "");
+	}
+
+	char *result = create_path(path, "");
+	result[slash == path ? 1 : slash - path] = '\0';
+	return result;
+}
+
+/***************************************************************************
+ * The function reads the records of a file and applies them to the
+ * context. The file is read with a single read and the keys and values are
+ * used directly from the buffer. Replaying stops at the first incomplete or
+ * corrupt record, which is the torn tail of an interrupted write. The
+ * function returns the size of the valid part of the file.
+ **************************************************************************/
+
+static size_t replay_fd(BTP_ctx *ctx, const int fd, const char *path) {
+	struct stat st;
+
+	if (fstat(fd, &st) != 0) {
+		fprintf(stderr, "replay_fd() Unable to stat file: %s! Error: %s\n", path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	const size_t size = st.st_size;
+	if (size == 0) {
+		return 0;
+	}
+
+	char *data = malloc(size);
+	if (data == NULL) {
+		fprintf(stderr, "replay_fd() Unable allocate memory!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	size_t len = 0;
+	while (len < size) {
+		const ssize_t count = pread(fd, data + len, size - len, len);
+
+		if (count < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (count <= 0) {
+			fprintf(stderr, "replay_fd() Unable to read file: %s! Error: %s\n", path, strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		len += count;
+	}
+
+	if (size < MAGIC_LEN || memcmp(data, MAGIC, MAGIC_LEN) != 0) {
+		fprintf(stderr, "replay_fd() File: %s is not a journal!\n", path);
+		exit(EXIT_FAILURE);
+	}
+
+	size_t offset = MAGIC_LEN;
+	int num_records = 0;
+
+	while (offset + RECORD_HEADER <= size) {
+		const char *record = data + offset;
+		uint32_t key_len;
+		uint32_t value_len;
+
+		memcpy(&key_len, record + 1, sizeof(uint32_t));
+		memcpy(&value_len, record + 1 + sizeof(uint32_t), sizeof(uint32_t));
+
+		//
+		// the lengths are compared with the remaining bytes to prevent overflows
+		//
+		const size_t remaining = size - offset;
+		if (key_len >= remaining || value_len >= remaining || RECORD_SIZE((size_t) key_len, (size_t) value_len) > remaining) {
+			break;
+		}
+
+		char *key = (char *) record + RECORD_HEADER;
+		char *value = key + key_len + 1;
+		const char *end = value + value_len + 1;
+		uint32_t sum;
+		memcpy(&sum, end, sizeof(uint32_t));
+
+		if (key[key_len] != '\0' || value[value_len] != '\0' || sum != checksum(record, end - record)) {
+			break;
+		}
+
+		//
+		// add and replace records are both applied with replace, so the
+		// replay is idempotent
+		//
+		switch (record[0]) {
+		case BTP_JOURNAL_ADD:
+		case BTP_JOURNAL_REPLACE:
+			btp_add_property(ctx, key, value, true);
+			break;
+		case BTP_JOURNAL_DELETE:
+			btp_delete_property(ctx, key);
+			break;
+		default:
+			fprintf(stderr, "replay_fd() File: %s unknown record type: %d\n", path, record[0]);
+			exit(EXIT_FAILURE);
+		}
+
+		offset += end + sizeof(uint32_t) - record;
+		num_records++;
+	}
+
+	print_debug("replay_fd() File: '%s' records: %d valid bytes: %zu of: %zu\n", path, num_records, offset, size);
+
+	free(data);
+	return offset;
+}
+
+/***************************************************************************
+ * The function replays a file, if it exists. It returns true if the file
+ * exists.
+ **************************************************************************/
+
+static bool replay_file(BTP_ctx *ctx, const char *path) {
+	const int fd = open(path, O_RDONLY);
+
+	if (fd < 0) {
+		if (errno == ENOENT) {
+			return false;
+		}
+		fprintf(stderr, "replay_file() Unable to open file: %s! Error: %s\n", path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	replay_fd(ctx, fd, path);
+	close(fd);
+	return true;
+}
+
+/***************************************************************************
+ * The function creates a new and empty journal file, which only contains
+ * the magic string. The directory is synced, so the records that are
+ * synced later cannot be lost with the directory entry.
+ **************************************************************************/
+
+static int create_journal_file(const char *path, const char *dir_path) {
+	const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if (fd < 0) {
+		fprintf(stderr, "create_journal_file() Unable to open file: %s! Error: %s\n", path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	write_all(fd, MAGIC, MAGIC_LEN, path);
+	sync_fd(fd, path);
+	sync_dir(dir_path);
+	return fd;
+}
+
+/***************************************************************************
+ * The function writes a buffer to a temporary file and renames it, so the
+ * file is replaced atomically. The directory is synced after the rename.
+ **************************************************************************/
+
+static void write_file_atomic(const char *tmp_path, const char *path, const char *dir_path, const Buffer *buffer) {
+	const int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if (fd < 0) {
+		fprintf(stderr, "write_file_atomic() Unable to open file: %s! Error: %s\n", tmp_path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	write_all(fd, buffer->data, buffer->len, tmp_path);
+	sync_fd(fd, tmp_path);
+	close(fd);
+
+	if (rename(tmp_path, path) != 0) {
+		fprintf(stderr, "write_file_atomic() Unable to rename file: %s! Error: %s\n", tmp_path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	sync_dir(dir_path);
+}
+
+/***************************************************************************
+ * The function is a callback for the iterator. It adds the key / value
+ * pair to the stored snapshot buffer.
+ **************************************************************************/
+
+static void snapshot_callback(const char *key, const char *value) {
+	buffer_append_record(stored_snapshot, BTP_JOURNAL_ADD, key, value);
+}
+
+/***************************************************************************
+ * The function serializes all entries of the context to the snapshot
+ * buffer.
+ **************************************************************************/
+
+static void create_snapshot(const BTP_ctx *ctx, Buffer *snapshot) {
+
+	snapshot->len = 0;
+	buffer_reserve(snapshot, MAGIC_LEN);
+	memcpy(snapshot->data, MAGIC, MAGIC_LEN);
+	snapshot->len = MAGIC_LEN;
+
+	stored_snapshot = snapshot;
+	btp_journal_walk(ctx, snapshot_callback);
+	stored_snapshot = NULL;
+}
+
+/***************************************************************************
+ * The function writes the snapshot of a context as the new base file.
+ * After that, the previous journal is no longer necessary. The removal is
+ * synced, so it cannot be durable before the new base file.
+ **************************************************************************/
+
+static void write_base(const BTP_journal *journal, const BTP_ctx *ctx) {
+	Buffer snapshot = { NULL, 0, 0 };
+
+	create_snapshot(ctx, &snapshot);
+	write_file_atomic(journal->tmp_path, journal->base_path, journal->dir_path, &snapshot);
+
+	if (unlink(journal->prev_path) != 0) {
+		if (errno != ENOENT) {
+			fprintf(stderr, "write_base() Unable to remove file: %s! Error: %s\n", journal->prev_path, strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+	} else {
+		sync_dir(journal->dir_path);
+	}
+
+	print_debug("write_base() Written base: '%s' bytes: %zu\n", journal->base_path, snapshot.len);
+	free(snapshot.data);
+}
+
+/***************************************************************************
+ * The function is the main function of the compaction thread. The base
+ * file and the previous journal are not changed by the writer, so the
+ * thread replays them into a private context, which is the state of the
+ * context at the start of the compaction. The private context is written
+ * as the new base file.
+ **************************************************************************/
+
+static void *compactor_main(void *ptr) {
+	BTP_journal *journal = (BTP_journal *) ptr;
+	BTP_ctx *ctx = btp_create_ctx();
+
+	replay_file(ctx, journal->base_path);
+	replay_file(ctx, journal->prev_path);
+
+	write_base(journal, ctx);
+	btp_destroy_ctx(ctx);
+
+	atomic_store(&journal->compacted, true);
+
+	return NULL;
+}
+
+/***************************************************************************
+ * The function waits for a running compaction.
+ **************************************************************************/
+
+static void join_compactor(BTP_journal *journal) {
+
+	if (!journal->compacting) {
+		return;
+	}
+
+	pthread_join(journal->compactor, NULL);
+	journal->compacting = false;
+}
+
+/***************************************************************************
+ * The function writes the buffered records with a single write and fsync.
+ **************************************************************************/
+
+static void flush_journal(BTP_journal *journal) {
+
+	if (journal->buffer.len == 0) {
+		return;
+	}
+
+	write_all(journal->fd, journal->buffer.data, journal->buffer.len, journal->path);
+	sync_fd(journal->fd, journal->path);
+
+	print_debug("flush_journal() Synced records: %d bytes: %zu\n", journal->pending, journal->buffer.len);
+
+	journal->buffer.len = 0;
+	journal->pending = 0;
+}
+
+/***************************************************************************
+ * The function starts a compaction. The current journal becomes the
+ * previous journal and a new journal is started. The caller only renames
+ * and creates a file, the new base file is built by a background thread
+ * from the files. Until the new base file is written, a replay uses the
+ * old base file, the previous and the current journal. Replaying a journal
+ * on a newer base is idempotent.
+ **************************************************************************/
+
+static void start_compaction(BTP_journal *journal) {
+	print_debug("start_compaction() Journal: '%s' size: %zu\n", journal->path, journal->size);
+
+	flush_journal(journal);
+	close(journal->fd);
+
+	if (rename(journal->path, journal->prev_path) != 0) {
+		fprintf(stderr, "start_compaction() Unable to rename file: %s! Error: %s\n", journal->path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	sync_dir(journal->dir_path);
+
+	journal->fd = create_journal_file(journal->path, journal->dir_path);
+	journal->size = MAGIC_LEN;
+
+	atomic_store(&journal->compacted, false);
+	if (pthread_create(&journal->compactor, NULL, compactor_main, journal) != 0) {
+		fprintf(stderr, "start_compaction() Unable to create thread!\n");
+		exit(EXIT_FAILURE);
+	}
+	journal->compacting = true;
+}
+
+/***************************************************************************
+ * The function opens a journal and attaches it to the context. The base
+ * file, the previous journal of an interrupted compaction and the journal
+ * are replayed into the context. A sync_batch or compact_size of 0 selects
+ * the default value. Entries of the context, that are not in the files, are
+ * written to a new base file, because a compaction only uses the files.
+ **************************************************************************/
+
+BTP_journal *btp_journal_open(BTP_ctx *ctx, const char *path, const int sync_batch, const size_t compact_size) {
+	print_debug("btp_journal_open() Opening journal: '%s'\n", path);
+
+	if (ctx->journal != NULL) {
+		fprintf(stderr, "btp_journal_open() Context has already a journal!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	BTP_journal *journal = calloc(1, sizeof(BTP_journal));
+	if (journal == NULL) {
+		fprintf(stderr, "btp_journal_open() Unable allocate memory!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	journal->ctx = ctx;
+	journal->path = create_path(path, "");
+	journal->base_path = create_path(path, ".base");
+	journal->prev_path = create_path(path, ".prev");
+	journal->tmp_path = create_path(path, ".tmp");
+	journal->dir_path = create_dir_path(path);
+	journal->sync_batch = sync_batch > 0 ? sync_batch : BTP_JOURNAL_SYNC_BATCH;
+	journal->compact_size = compact_size > 0 ? compact_size : BTP_JOURNAL_COMPACT_SIZE;
+
+	const bool has_entries = ctx->num_entries > 0;
+
+	//
+	// replay the base file and the previous journal
+	//
+	replay_file(ctx, journal->base_path);
+	const bool has_prev = replay_file(ctx, journal->prev_path);
+
+	//
+	// replay the journal and remove a torn tail
+	//
+	journal->fd = open(journal->path, O_RDWR | O_CREAT, 0644);
+	if (journal->fd < 0) {
+		fprintf(stderr, "btp_journal_open() Unable to open file: %s! Error: %s\n", journal->path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	journal->size = replay_fd(ctx, journal->fd, journal->path);
+
+	if (journal->size == 0) {
+		close(journal->fd);
+		journal->fd = create_journal_file(journal->path, journal->dir_path);
+		journal->size = MAGIC_LEN;
+
+	} else if (ftruncate(journal->fd, journal->size) != 0) {
+		fprintf(stderr, "btp_journal_open() Unable to truncate file: %s! Error: %s\n", journal->path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	if (lseek(journal->fd, 0, SEEK_END) < 0) {
+		fprintf(stderr, "btp_journal_open() Unable to seek file: %s! Error: %s\n", journal->path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	//
+	// finish an interrupted compaction and store the entries of the context
+	//
+	if (has_prev || has_entries) {
+		write_base(journal, ctx);
+	}
+
+	ctx->journal = journal;
+
+	print_debug("btp_journal_open() Opened journal: '%s' size: %zu num entries: %d\n", path, journal->size, ctx->num_entries);
+	return journal;
+}
+
+/***************************************************************************
+ * The function appends a record to the journal. The record is written to
+ * the disk with the next full batch or the next call of btp_journal_sync.
+ **************************************************************************/
+
+void btp_journal_append(BTP_journal *journal, const char type, const char *key, const char *value) {
+	const size_t len = journal->buffer.len;
+
+	buffer_append_record(&journal->buffer, type, key, value == NULL ? "" : value);
+	journal->size += journal->buffer.len - len;
+	journal->pending++;
+
+	if (journal->pending >= journal->sync_batch) {
+		flush_journal(journal);
+	}
+
+	//
+	// a finished compaction is joined before the next one can start
+	//
+	if (journal->compacting && atomic_load(&journal->compacted)) {
+		join_compactor(journal);
+	}
+
+	if (!journal->compacting && journal->size >= journal->compact_size) {
+		start_compaction(journal);
+	}
+}
+
+/***************************************************************************
+ * The function writes all pending records to the disk.
+ **************************************************************************/
+
+void btp_journal_sync(BTP_journal *journal) {
+	flush_journal(journal);
+}
+
+/***************************************************************************
+ * The function writes all pending records, waits for a running compaction
+ * and detaches the journal from the context.
+ **************************************************************************/
+
+void btp_journal_close(BTP_journal *journal) {
+	flush_journal(journal);
+	join_compactor(journal);
+
+	close(journal->fd);
+	journal->ctx->journal = NULL;
+
+	print_debug("btp_journal_close() Closed journal: '%s'\n", journal->path);
+
+	free(journal->path);
+	free(journal->base_path);
+	free(journal->prev_path);
+	free(journal->tmp_path);
+	free(journal->dir_path);
+	free(journal->buffer.data);
+	free(journal);
+}
@@ -18,9 +18,15 @@
 #include <string.h>
 #include <errno.h>
 #include <search.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
 
 #include "btree_properties.h"
 #include "btree_utils.h"
+#include "btree_journal.h"
 
 //
 // Definition of the print_debug macro.
@@ -34,62 +40,265 @@
 
 #define MAX_LINE 1024
 
+//
+// The size of a node of the glibc btree, which consists of the key pointer
+// and the pointers to the left and the right node.
+//
+#define NODE_SIZE (3 * sizeof(void *))
+
+//
+// The size and the alignment of the blocks of the arena, which contains the
+// compacted entries. The address of a block is a multiple of its size, so
+// the block of an entry is found by masking the address of the entry.
+//
+#define SLAB_SIZE 2048
+
+//
+// The alignment of the entries in the arena.
+//
+#define ENTRY_ALIGN sizeof(void *)
+#define ALIGN_ENTRY(size) (((size) + ENTRY_ALIGN - 1) & ~(ENTRY_ALIGN - 1))
+
 //
 // A pointer to the callback function,which is used by the iterator function.
 //
 static void (*stored_callback)(const char *key, const char *value);
 
+//
+// A pointer to the callback function of the journal, which is separate from
+// the iterator, because a snapshot can be written during an iteration. The
+// compaction thread of a journal writes snapshots, so it is per thread.
+//
+static __thread void (*stored_journal_callback)(const char *key, const char *value);
+
+//
+// The array and its size, which is filled by the collector function with
+// the entries in sorted order.
+//
+static const void **stored_entries;
+static int stored_num;
+
+//
+// The memory usage, which is updated by the memory counter function.
+//
+static BTP_memory *stored_memory;
+
+//
+// The source of the generations of all contexts. A generation is never used
+// twice, so a new context at the address of a destroyed context does not
+// match the cached lookups of the old one.
+//
+static atomic_ulong last_generation;
+
 /***************************************************************************
- * An entry consists of a string key and a string value.
+ * An entry consists of a string key and a string value. The entry, the key
+ * and the initial value are allocated as a single block, with the key and
+ * the value directly behind the struct. A replaced value is copied to the
+ * inline buffer if it fits, otherwise it is allocated separately. An entry,
+ * that was moved by a compaction, is located in the arena of the context.
  **************************************************************************/
 
 typedef struct Entry {
 	char *key;
 	char *value;
+	unsigned int key_len;
+	unsigned int capacity :31;
+	unsigned int in_arena :1;
 } Entry;
 
 /***************************************************************************
- * The method creates an entry with a given key and value. NULL keys or
- * values are not allowed.
+ * A block of the arena. The entries are placed behind the header in the
+ * order of the compaction, which is the order of the keys. The used bytes
+ * are the bytes of the entries, that are not freed. A block is freed with
+ * its last entry, unless it is the current block of the arena.
+ **************************************************************************/
+
+typedef struct Slab {
+	struct BTP_arena *arena;
+	struct Slab *prev;
+	struct Slab *next;
+	size_t fill;
+	size_t used;
+} Slab;
+
+/***************************************************************************
+ * The arena of a context with the list of its blocks and the block, which
+ * is filled by the running compaction.
+ **************************************************************************/
+
+typedef struct BTP_arena {
+	Slab *slabs;
+	Slab *current;
+} BTP_arena;
+
+/***************************************************************************
+ * The function returns the inline value buffer of an entry, which is
+ * located behind the key.
+ **************************************************************************/
+
+static char *entry_inline_value(const Entry *entry) {
+	return entry->key + entry->key_len + 1;
+}
+
+/***************************************************************************
+ * The function copies the key and the value behind the struct of an entry.
+ **************************************************************************/
+
+static void init_entry(Entry *entry, const char *key, const size_t key_len, const char *value, const size_t value_len, const bool in_arena) {
+	entry->key = (char *) (entry + 1);
+	entry->key_len = key_len;
+	memcpy(entry->key, key, key_len + 1);
+
+	entry->value = entry_inline_value(entry);
+	entry->capacity = value_len + 1;
+	entry->in_arena = in_arena;
+	memcpy(entry->value, value, value_len + 1);
+}
+
+/***************************************************************************
+ * The method creates an entry with a given key and value. The key and the
+ * value have to be checked by the caller. The function returns NULL if the
+ * memory cannot be allocated.
  **************************************************************************/
 
 static Entry *create_entry(const char *key, const char *value) {
+	const size_t key_len = strlen(key);
+	const size_t value_len = strlen(value);
 
 	//
-	// ensure that the key and the value are not null
+	// allocate memory for the entry, the key and the value
 	//
-	if (key == NULL) {
-		fprintf(stderr, "create_entry() Key is NULL!\n");
-		exit(EXIT_FAILURE);
+	Entry *entry = malloc(sizeof(Entry) + key_len + 1 + value_len + 1);
+
+	if (entry == NULL) {
+		print_debug("create_entry() Unable allocate memory for key: '%s'\n", key);
+		return NULL;
 	}
 
-	if (value == NULL) {
-		fprintf(stderr, "create_entry() Value is NULL for key: '%s'!\n", key);
-		exit(EXIT_FAILURE);
+	init_entry(entry, key, key_len, value, value_len, false);
+
+	print_debug("create_entry() key: '%s' value: '%s'\n", entry->key, entry->value);
+
+	return entry;
+}
+
+/***************************************************************************
+ * The function returns the size of the block of an entry in the arena.
+ **************************************************************************/
+
+static size_t arena_entry_size(const Entry *entry) {
+	return ALIGN_ENTRY(sizeof(Entry) + entry->key_len + 1 + entry->capacity);
+}
+
+/***************************************************************************
+ * The function returns the memory of the block of an entry, which is
+ * located in the arena or allocated with malloc.
+ **************************************************************************/
+
+static size_t entry_size(const Entry *entry) {
+	return entry->in_arena ? arena_entry_size(entry) : malloc_usable_size((void *) entry);
+}
+
+/***************************************************************************
+ * The function removes a block from the list of its arena and frees it.
+ **************************************************************************/
+
+static void free_slab(Slab *slab) {
+
+	if (slab->prev == NULL) {
+		slab->arena->slabs = slab->next;
+	} else {
+		slab->prev->next = slab->next;
 	}
 
-	//
-	// allocate memory for the entry
-	//
-	Entry *entry = malloc(sizeof(Entry));
+	if (slab->next != NULL) {
+		slab->next->prev = slab->prev;
+	}
 
-	if (entry == NULL) {
-		fprintf(stderr, "create_entry() Unable allocate memory!\n");
-		exit(EXIT_FAILURE);
+	free(slab);
+}
+
+/***************************************************************************
+ * The function frees the block of an entry. An entry in the arena is freed
+ * by its block, if it was the last entry of the block.
+ **************************************************************************/
+
+static void free_entry_block(Entry *entry) {
+
+	if (!entry->in_arena) {
+		free(entry);
+		return;
 	}
 
-	//
-	// duplicate the key and the value
-	//
-	entry->key = strdup(key);
-	entry->value = strdup(value);
+	Slab *slab = (Slab *) ((uintptr_t) entry & ~(uintptr_t) (SLAB_SIZE - 1));
+	slab->used -= arena_entry_size(entry);
 
-	if (entry->key == NULL || entry->value == NULL) {
-		fprintf(stderr, "create_entry() Unable allocate memory!\n");
-		exit(EXIT_FAILURE);
+	if (slab->used == 0 && slab != slab->arena->current) {
+		free_slab(slab);
 	}
+}
 
-	print_debug("create_entry() key: '%s' value: '%s'\n", entry->key, entry->value);
+/***************************************************************************
+ * The function ends the filling of the current block of the arena. The
+ * block is freed, if its entries were already freed.
+ **************************************************************************/
+
+static void arena_release_current(BTP_arena *arena) {
+	Slab *slab = arena->current;
+
+	arena->current = NULL;
+
+	if (slab != NULL && slab->used == 0) {
+		free_slab(slab);
+	}
+}
+
+/***************************************************************************
+ * The function creates an entry in the current block of the arena, so the
+ * entries of a compaction are densely packed in the order of the keys. A
+ * new block is started, if the entry does not fit. An entry, that is too
+ * large for a block, is allocated with malloc. The function returns NULL
+ * if the memory cannot be allocated.
+ **************************************************************************/
+
+static Entry *arena_create_entry(BTP_arena *arena, const char *key, const char *value) {
+	const size_t key_len = strlen(key);
+	const size_t value_len = strlen(value);
+	const size_t size = ALIGN_ENTRY(sizeof(Entry) + key_len + 1 + value_len + 1);
+
+	if (size > SLAB_SIZE - ALIGN_ENTRY(sizeof(Slab))) {
+		return create_entry(key, value);
+	}
+
+	Slab *slab = arena->current;
+
+	if (slab == NULL || slab->fill + size > SLAB_SIZE) {
+		arena_release_current(arena);
+
+		slab = aligned_alloc(SLAB_SIZE, SLAB_SIZE);
+		if (slab == NULL) {
+			print_debug("arena_create_entry() Unable allocate memory for key: '%s'\n", key);
+			return NULL;
+		}
+
+		slab->arena = arena;
+		slab->prev = NULL;
+		slab->next = arena->slabs;
+		slab->fill = ALIGN_ENTRY(sizeof(Slab));
+		slab->used = 0;
+
+		if (arena->slabs != NULL) {
+			arena->slabs->prev = slab;
+		}
+		arena->slabs = slab;
+		arena->current = slab;
+	}
+
+	Entry *entry = (Entry *) ((char *) slab + slab->fill);
+	slab->fill += size;
+	slab->used += size;
+
+	init_entry(entry, key, key_len, value, value_len, true);
 
 	return entry;
 }
@@ -111,36 +320,63 @@ static void delete_entry(void *ptr) {
 	print_debug("delete_entry() key: '%s' value: '%s'\n", entry->key, entry->value);
 
 	//
-	// free the duplicated key and value and the entry struct
+	// free a separately allocated value and the entry block
 	//
-	free(entry->key);
-	free(entry->value);
-	free(entry);
+	if (entry->value != entry_inline_value(entry)) {
+		free(entry->value);
+	}
+	free_entry_block(entry);
 }
 
 /***************************************************************************
- * The method replaces the value of a given entry. The old value has to be
- * freed.
+ * The method replaces the value of a given entry. If the new value fits in
+ * the inline buffer, it is copied there. Otherwise the new value is
+ * duplicated and a separately allocated old value has to be freed. The
+ * function returns false, if the memory cannot be allocated. In this case
+ * the entry is unchanged.
  **************************************************************************/
 
-static void replace_entry_value(Entry *entry, const char *new_value) {
+static bool replace_entry_value(Entry *entry, const char *new_value) {
 	print_debug("replace_entry_value() Replace key: '%s' old value: '%s' new value: '%s'\n", entry->key, entry->value, new_value);
 
-	free(entry->value);
-	entry->value = strdup(new_value);
+	const size_t len = strlen(new_value) + 1;
+	char *inline_value = entry_inline_value(entry);
+
+	if (len <= entry->capacity) {
+		memmove(inline_value, new_value, len);
+
+		if (entry->value != inline_value) {
+			free(entry->value);
+			entry->value = inline_value;
+		}
+		return true;
+	}
+
+	char *value = strdup(new_value);
+
+	if (value == NULL) {
+		return false;
+	}
+
+	if (entry->value != inline_value) {
+		free(entry->value);
+	}
+	entry->value = value;
+	return true;
 }
 
 /***************************************************************************
  * The function is a callback handler that compares two entries. Two entries
  * are equal if the keys are equal. The method is used to find entries by a
- * given key.
+ * given key. The public functions reject NULL keys, so NULL entries cannot
+ * occur. If they do, they are sorted first instead of exiting.
  **************************************************************************/
 
 static int compare_entries(const void *ptr1, const void *ptr2) {
 
 	if (ptr1 == NULL || ptr2 == NULL) {
-		fprintf(stderr, "compare_entries() Entry is NULL\n");
-		exit(EXIT_FAILURE);
+		print_debug("compare_entries() Entry is NULL\n");
+		return (ptr1 != NULL) - (ptr2 != NULL);
 	}
 
 	const Entry *entry1 = (const Entry *) ptr1;
@@ -151,6 +387,134 @@ static int compare_entries(const void *ptr1, const void *ptr2) {
 	return strcmp(entry1->key, entry2->key);
 }
 
+/***************************************************************************
+ * The function returns a new generation for a changed context.
+ **************************************************************************/
+
+static unsigned long next_generation() {
+	return atomic_fetch_add(&last_generation, 1) + 1;
+}
+
+/***************************************************************************
+ * The function fills the error report, if one is given, and returns false,
+ * so it can be used as the return value of a failing function.
+ **************************************************************************/
+
+static bool set_error(BTP_error *error, const BTP_error_code code, const char *file, const int line, const char *fmt, ...) {
+	va_list args;
+
+	if (error == NULL) {
+		return false;
+	}
+
+	error->code = code;
+	error->file = file;
+	error->line = line;
+
+	va_start(args, fmt);
+	vsnprintf(error->reason, BTP_ERROR_REASON, fmt, args);
+	va_end(args);
+
+	print_debug("set_error() Code: %d file: '%s' line: %d reason: %s\n", code, file == NULL ? "" : file, line, error->reason);
+	return false;
+}
+
+#ifdef BTP_LOOKUP_CACHE
+
+/***************************************************************************
+ * A line of the lookup cache. It contains the entry, that was found for a
+ * key pointer in a context with a given generation.
+ **************************************************************************/
+
+typedef struct Cache_line {
+	const BTP_ctx *ctx;
+	unsigned long generation;
+	const char *key;
+	const Entry *entry;
+} Cache_line;
+
+//
+// The direct mapped lookup cache of the thread.
+//
+static __thread Cache_line lookup_cache[BTP_LOOKUP_CACHE_SIZE];
+
+/***************************************************************************
+ * The function returns the cache line for a context and a key pointer.
+ **************************************************************************/
+
+static Cache_line *get_cache_line(const BTP_ctx *ctx, const char *key) {
+	uintptr_t hash = (uintptr_t) key ^ ((uintptr_t) ctx >> 4);
+
+	hash ^= hash >> 7;
+	hash ^= hash >> 13;
+
+	return &lookup_cache[hash & (BTP_LOOKUP_CACHE_SIZE - 1)];
+}
+
+#endif
+
+/***************************************************************************
+ * The state of a running compaction. The entries are the entries of the
+ * context in sorted order, at the start of the compaction, and the index
+ * is the next entry to compact. Entries that are removed from the context
+ * during the compaction are retired instead of freed, so the pointers of
+ * the array stay valid. A retired entry has a NULL key and its value
+ * pointer links to the next retired entry.
+ **************************************************************************/
+
+typedef struct BTP_compaction {
+	const Entry **entries;
+	int num_entries;
+	int idx;
+	Entry *retired;
+} BTP_compaction;
+
+/***************************************************************************
+ * The function frees the compaction state of a context and the retired
+ * entries.
+ **************************************************************************/
+
+static void free_compaction(BTP_ctx *ctx) {
+	Entry *entry = ctx->compaction->retired;
+
+	while (entry != NULL) {
+		Entry *next = (Entry *) entry->value;
+		free_entry_block(entry);
+		entry = next;
+	}
+
+	arena_release_current(ctx->arena);
+
+	free(ctx->compaction->entries);
+	free(ctx->compaction);
+	ctx->compaction = NULL;
+}
+
+/***************************************************************************
+ * The function frees an entry, that was removed from the context. During a
+ * compaction, the entry may still be referenced by the compaction, so only
+ * a separately allocated value is freed and the entry is retired until the
+ * compaction is finished.
+ **************************************************************************/
+
+static void release_entry(BTP_ctx *ctx, Entry *entry) {
+
+	if (ctx->compaction == NULL) {
+		delete_entry(entry);
+		return;
+	}
+
+	print_debug("release_entry() Retire key: '%s'\n", entry->key);
+
+	if (entry->value != entry_inline_value(entry)) {
+		free(entry->value);
+	}
+
+	entry->key = NULL;
+	entry->value = (char *) ctx->compaction->retired;
+	ctx->compaction->retired = entry;
+}
+
 /***************************************************************************
  * The method creates a btree context, which is used to store all the btree
  * data.
@@ -165,6 +529,10 @@ BTP_ctx *btp_create_ctx() {
 
 	ctx->root = NULL;
 	ctx->num_entries = 0;
+	ctx->generation = next_generation();
+	ctx->journal = NULL;
+	ctx->compaction = NULL;
+	ctx->arena = NULL;
 
 	print_debug("btp_create_ctx() Created context.\n");
 	return ctx;
@@ -174,7 +542,20 @@ BTP_ctx *btp_create_ctx() {
  * The method destroys a btree context and frees all the related memory.
  **************************************************************************/
 void btp_destroy_ctx(BTP_ctx *ctx) {
+
+	if (ctx->journal != NULL) {
+		btp_journal_close(ctx->journal);
+	}
+
+	if (ctx->compaction != NULL) {
+		free_compaction(ctx);
+	}
+
+	//
+	// the blocks of the arena are freed with their entries
+	//
 	tdestroy(ctx->root, delete_entry);
+	free(ctx->arena);
 	free(ctx);
 	print_debug("btp_destroy_ctx() Finished.\n");
 }
@@ -204,6 +585,32 @@ static void iterator(const void *nodep, const VISIT which, const int depth) {
 	}
 }
 
+/***************************************************************************
+ * The function is a callback handler for the twalk function, which is used
+ * to write the snapshots of the journal.
+ **************************************************************************/
+
+static void journal_walker(const void *nodep, const VISIT which, const int depth) {
+
+	if (which == leaf || which == preorder) {
+		const Entry *entry = *(const Entry **) nodep;
+		stored_journal_callback(entry->key, entry->value);
+	}
+}
+
+/***************************************************************************
+ * The function calls the callback of the journal for each entry. Unlike
+ * btp_iterate_properties, it writes nothing to stdout, because it is
+ * called while a change is recorded.
+ **************************************************************************/
+
+void btp_journal_walk(const BTP_ctx *ctx, void (*callback)(const char *key, const char *value)) {
+
+	stored_journal_callback = callback;
+	twalk(ctx->root, journal_walker);
+	stored_journal_callback = NULL;
+}
+
 /***************************************************************************
  * The function set the callback handler of the user to the stored_callback
  * and calls the twalk with the adapter callback function iterator.
@@ -220,19 +627,38 @@ void btp_iterate_properties(const BTP_ctx *ctx, void (*user_callback)(const char
 
 /***************************************************************************
  * The function adds a key value pair to the properties, if the key not
- * already exists. In this case the method returns true. If the value
- * exists, the function returns false. If the parameter replace is true, the
- * value will be replaced. If the value is false, no changes are made.
+ * already exists. In this case added is set to true. If the value exists,
+ * added is set to false. If the parameter replace is true, the value will
+ * be replaced. If the value is false, no changes are made. The function
+ * returns false and fills the error report, if the key or the value is
+ * NULL or the memory cannot be allocated. In this case the context is
+ * unchanged.
  **************************************************************************/
 
-bool btp_add_property(BTP_ctx *ctx, char *key, const char *value, const bool replace) {
-	print_debug("btp_add_property() key: '%s' value: '%s' replace: %d \n", key, value, replace);
+bool btp_try_add_property(BTP_ctx *ctx, char *key, const char *value, const bool replace, bool *added, BTP_error *error) {
+
+	if (added != NULL) {
+		*added = false;
+	}
+
+	//
+	// ensure that the key and the value are not null
+	//
+	if (key == NULL) {
+		return set_error(error, BTP_ERROR_ARGUMENT, NULL, 0, "Key is NULL");
+	}
+
+	if (value == NULL) {
+		return set_error(error, BTP_ERROR_ARGUMENT, NULL, 0, "Value is NULL for key: '%s'", key);
+	}
+
+	print_debug("btp_try_add_property() key: '%s' value: '%s' replace: %d \n", key, value, replace);
 
 	//
 	// check if the property already exists
 	//
-	const Entry search_key = { key, NULL, true };
-	print_debug("btp_add_property() Search key: '%s'\n", search_key.key);
+	const Entry search_key = { key, NULL };
+	print_debug("btp_try_add_property() Search key: '%s'\n", search_key.key);
 	const void *ptr = tfind(&search_key, &(ctx->root), compare_entries);
 
 	if (ptr != NULL) {
@@ -242,37 +668,74 @@ bool btp_add_property(BTP_ctx *ctx, char *key, const char *value, const bool rep
 		// entry with the key found but replace is not allowed => error
 		//
 		if (!replace) {
-			print_debug("btp_add_property() Key: '%s' already defined with value: '%s'\n", search_result->key, search_result->value);
+			print_debug("btp_try_add_property() Key: '%s' already defined with value: '%s'\n", search_result->key, search_result->value);
 
 			//
 			// entry with the key found => free old value and duplicate new value
 			//
 		} else {
-			replace_entry_value(search_result, value);
+			if (!replace_entry_value(search_result, value)) {
+				return set_error(error, BTP_ERROR_MEMORY, NULL, 0, "Unable allocate memory for key: '%s'", key);
+			}
+			ctx->generation = next_generation();
+
+			if (ctx->journal != NULL) {
+				btp_journal_append(ctx->journal, BTP_JOURNAL_REPLACE, search_result->key, search_result->value);
+			}
 		}
 
 		//
-		// if an entry was found the function returns false (not added, perhaps replaced)
+		// if an entry was found, the property is not added (perhaps replaced)
 		//
-		return false;
+		return true;
 	}
 	//
 	// create and add property
 	//
-	const Entry *entry = create_entry(key, value);
-	print_debug("btp_add_property() Created key: '%s' value: '%s'\n", entry->key, entry->value);
+	Entry *entry = create_entry(key, value);
+	if (entry == NULL) {
+		return set_error(error, BTP_ERROR_MEMORY, NULL, 0, "Unable allocate memory for key: '%s'", key);
+	}
+	print_debug("btp_try_add_property() Created key: '%s' value: '%s'\n", entry->key, entry->value);
 
-#ifdef DEBUG
-	const Entry *add_result = *(Entry **)
-#endif
-	tsearch((void *) entry, &(ctx->root), compare_entries);
+	if (tsearch((void *) entry, &(ctx->root), compare_entries) == NULL) {
+		delete_entry(entry);
+		return set_error(error, BTP_ERROR_MEMORY, NULL, 0, "Unable allocate memory for key: '%s'", key);
+	}
 	ctx->num_entries++;
+	ctx->generation = next_generation();
 
-	print_debug("btp_add_property() Added key: '%s' value: '%s' num entries: %d\n", add_result->key, add_result->value, ctx->num_entries);
+	print_debug("btp_try_add_property() Added key: '%s' value: '%s' num entries: %d\n", entry->key, entry->value, ctx->num_entries);
+
+	if (ctx->journal != NULL) {
+		btp_journal_append(ctx->journal, BTP_JOURNAL_ADD, entry->key, entry->value);
+	}
 
+	if (added != NULL) {
+		*added = true;
+	}
 	return true;
 }
 
+/***************************************************************************
+ * The function adds a key value pair to the properties, if the key not
+ * already exists. In this case the method returns true. If the value
+ * exists, the function returns false. If the parameter replace is true, the
+ * value will be replaced. If the value is false, no changes are made.
+ **************************************************************************/
+
+bool btp_add_property(BTP_ctx *ctx, char *key, const char *value, const bool replace) {
+	BTP_error error;
+	bool added;
+
+	if (!btp_try_add_property(ctx, key, value, replace, &added, &error)) {
+		fprintf(stderr, "btp_add_property() %s!\n", error.reason);
+		exit(EXIT_FAILURE);
+	}
+
+	return added;
+}
+
 /***************************************************************************
  * The function adds a key value pair to the properties, if the key not
  * already exists.
@@ -280,10 +743,15 @@ bool btp_add_property(BTP_ctx *ctx, char *key, const char *value, const bool rep
 
 bool btp_delete_property(BTP_ctx *ctx, char *key) {
 
+	if (key == NULL) {
+		print_debug("btp_delete_property() Key is NULL!\n");
+		return false;
+	}
+
 	//
 	// check if the property exists
 	//
-	const Entry delete_key = { key, NULL, true };
+	const Entry delete_key = { key, NULL };
 	print_debug("btp_delete_property() search key: '%s'\n", delete_key.key);
 	void *ptr = tfind(&delete_key, &(ctx->root), compare_entries);
 
@@ -302,22 +770,41 @@ bool btp_delete_property(BTP_ctx *ctx, char *key) {
 	// delete the entry from the btree and free the memory
 	//
 	tdelete(&delete_key, &(ctx->root), compare_entries);
-	delete_entry(search_result);
+	release_entry(ctx, search_result);
 	ctx->num_entries--;
+	ctx->generation = next_generation();
 
 	print_debug("btp_delete_property() Entry for key: '%s' deleted and freed. Num entries: %d\n", delete_key.key, ctx->num_entries);
 
+	if (ctx->journal != NULL) {
+		btp_journal_append(ctx->journal, BTP_JOURNAL_DELETE, key, NULL);
+	}
+
 	return true;
 }
 
 /***************************************************************************
  * The method returns the value for a given key or null if it does not
- * exist.
+ * exist. With the lookup cache, a key pointer that was already found in the
+ * current generation of the context is compared only with the cached key.
  **************************************************************************/
 
 char *btp_get_property_value(const BTP_ctx *ctx, char *key) {
 
-	const Entry search_key = { key, NULL, true };
+	if (key == NULL) {
+		print_debug("btp_get_property_value() Key is NULL!\n");
+		return NULL;
+	}
+
+#ifdef BTP_LOOKUP_CACHE
+	Cache_line *line = get_cache_line(ctx, key);
+
+	if (line->ctx == ctx && line->generation == ctx->generation && line->key == key && strcmp(line->entry->key, key) == 0) {
+		return line->entry->value;
+	}
+#endif
+
+	const Entry search_key = { key, NULL };
 	print_debug("btp_get_property_value() Search key: '%s'\n", search_key.key);
 
 	const void *ptr = tfind(&search_key, &(ctx->root), compare_entries);
@@ -327,65 +814,682 @@ char *btp_get_property_value(const BTP_ctx *ctx, char *key) {
 	}
 
 	const Entry *entry = *(Entry **) ptr;
+
+#ifdef BTP_LOOKUP_CACHE
+	line->ctx = ctx;
+	line->generation = ctx->generation;
+	line->key = key;
+	line->entry = entry;
+#endif
+
 	return entry->value;
 }
 
 /***************************************************************************
- * The method reads the properties from a configuration file.
+ * The function is a callback handler for the twalk function. It adds the
+ * entries to the stored array. The postorder visit of an inner node is the
+ * visit between its left and right subtree, so the entries are sorted.
  **************************************************************************/
 
-void btp_read_properties(BTP_ctx *ctx, const char *filename) {
-	FILE *file;
-	char raw_line[MAX_LINE];
-	char *line;
-	char *idx;
-	int line_no = 0;
-	char *key;
-	char *value;
+static void collector(const void *nodep, const VISIT which, const int depth) {
 
-	print_debug("btp_read_properties() Opening file: '%s'\n", filename);
+	if (which == leaf || which == postorder) {
+		stored_entries[stored_num++] = *(const void **) nodep;
+	}
+}
 
-	file = fopen(filename, "r");
-	if (file == NULL) {
-		fprintf(stderr, "btp_read_properties() Unable to open file: %s! Error: %s\n", filename, strerror(errno));
+/***************************************************************************
+ * The function fills an array with the entries of the context, sorted by
+ * their keys. The array has to be large enough for all entries.
+ **************************************************************************/
+
+static void fill_entries(const BTP_ctx *ctx, const Entry **entries) {
+
+	stored_entries = (const void **) entries;
+	stored_num = 0;
+
+	twalk(ctx->root, collector);
+
+	stored_entries = NULL;
+
+	print_debug("fill_entries() Collected entries: %d\n", stored_num);
+}
+
+/***************************************************************************
+ * The function returns an array with the entries of the context, sorted by
+ * their keys. The array has to be freed by the caller.
+ **************************************************************************/
+
+static const Entry **collect_entries(const BTP_ctx *ctx) {
+	const Entry **entries = malloc((ctx->num_entries + 1) * sizeof(Entry *));
+
+	if (entries == NULL) {
+		fprintf(stderr, "collect_entries() Unable allocate memory!\n");
 		exit(EXIT_FAILURE);
 	}
 
-	while (fgets(raw_line, MAX_LINE, file) != NULL) {
-		line_no++;
+	fill_entries(ctx, entries);
+	return entries;
+}
+
+/***************************************************************************
+ * The function compares two contexts and calls the callback for each key,
+ * which was added, removed or changed from the first to the second
+ * context. Both contexts are walked in sorted order simultaneously, so the
+ * function runs in O(n+m) without lookups.
+ **************************************************************************/
+
+void btp_diff(const BTP_ctx *ctx_a, const BTP_ctx *ctx_b, void (*callback)(const BTP_diff_type type, const char *key, const char *value_a, const char *value_b)) {
+	const Entry **entries_a = collect_entries(ctx_a);
+	const Entry **entries_b = collect_entries(ctx_b);
+	int idx_a = 0;
+	int idx_b = 0;
 
-		line = trim(raw_line);
+	while (idx_a < ctx_a->num_entries || idx_b < ctx_b->num_entries) {
+		int cmp;
 
 		//
-		// skip empty lines or comments
+		// if one side is exhausted, the remaining entries of the other side are different
 		//
-		if (!*line || *line == '#') {
-			continue;
+		if (idx_a == ctx_a->num_entries) {
+			cmp = 1;
+		} else if (idx_b == ctx_b->num_entries) {
+			cmp = -1;
+		} else {
+			cmp = strcmp(entries_a[idx_a]->key, entries_b[idx_b]->key);
+		}
+
+		if (cmp < 0) {
+			callback(BTP_DIFF_REMOVED, entries_a[idx_a]->key, entries_a[idx_a]->value, NULL);
+			idx_a++;
+
+		} else if (cmp > 0) {
+			callback(BTP_DIFF_ADDED, entries_b[idx_b]->key, NULL, entries_b[idx_b]->value);
+			idx_b++;
+
+		} else {
+			if (strcmp(entries_a[idx_a]->value, entries_b[idx_b]->value) != 0) {
+				callback(BTP_DIFF_CHANGED, entries_a[idx_a]->key, entries_a[idx_a]->value, entries_b[idx_b]->value);
+			}
+			idx_a++;
+			idx_b++;
 		}
+	}
+
+	free(entries_a);
+	free(entries_b);
+}
+
+/***************************************************************************
+ * The function merges the source context into the destination context.
+ * Keys that only exist in the source are added. Keys that exist in both
+ * contexts are handled by the policy. Both contexts are walked in sorted
+ * order simultaneously. The function returns the number of keys of the
+ * destination, that were added, replaced or deleted. Missing keys are
+ * inserted with a single tsearch each, which is the only tree descent.
+ **************************************************************************/
+
+int btp_merge(BTP_ctx *dst, const BTP_ctx *src, const BTP_merge_policy policy) {
+	const int num_dst = dst->num_entries;
+	const int num_src = src->num_entries;
+	const Entry **entries_dst = collect_entries(dst);
+	const Entry **entries_src = collect_entries(src);
+	int idx_dst = 0;
+	int idx_src = 0;
+	int changes = 0;
+
+	print_debug("btp_merge() Num dst: %d num src: %d policy: %d\n", num_dst, num_src, policy);
+
+	while (idx_dst < num_dst || idx_src < num_src) {
+		int cmp;
 
-		print_debug("btp_read_properties() File: '%s' no: %d line: '%s'\n", filename, line_no, line);
+		if (idx_dst == num_dst) {
+			cmp = 1;
+		} else if (idx_src == num_src) {
+			cmp = -1;
+		} else {
+			cmp = strcmp(entries_dst[idx_dst]->key, entries_src[idx_src]->key);
+		}
 
 		//
-		// search = as a key / value delimiter
+		// key only in the destination => delete it with the mirror policy
 		//
-		idx = index(line, '=');
-		if (!idx) {
-			fprintf(stderr, "btp_read_properties() File: '%s' line: %d does not contain '='!\n", filename, line_no);
-			fclose(file);
+		if (cmp < 0) {
+			Entry *entry = (Entry *) entries_dst[idx_dst++];
+
+			if (policy == BTP_MERGE_MIRROR) {
+				tdelete(entry, &(dst->root), compare_entries);
+				dst->num_entries--;
+
+				if (dst->journal != NULL) {
+					btp_journal_append(dst->journal, BTP_JOURNAL_DELETE, entry->key, NULL);
+				}
+
+				release_entry(dst, entry);
+				changes++;
+			}
+
+			//
+			// key only in the source => add it
+			//
+		} else if (cmp > 0) {
+			const Entry *src_entry = entries_src[idx_src++];
+			Entry *entry = create_entry(src_entry->key, src_entry->value);
+
+			//
+			// the key is known to be missing, so it is inserted without a tfind
+			//
+			if (entry == NULL || tsearch(entry, &(dst->root), compare_entries) == NULL) {
+				fprintf(stderr, "btp_merge() Unable allocate memory!\n");
+				exit(EXIT_FAILURE);
+			}
+			dst->num_entries++;
+
+			if (dst->journal != NULL) {
+				btp_journal_append(dst->journal, BTP_JOURNAL_ADD, entry->key, entry->value);
+			}
+			changes++;
+
+			//
+			// key in both => replace a different value, if the policy allows it
+			//
+		} else {
+			Entry *entry = (Entry *) entries_dst[idx_dst++];
+			const char *value = entries_src[idx_src++]->value;
+
+			if (policy != BTP_MERGE_KEEP && strcmp(entry->value, value) != 0) {
+
+				if (!replace_entry_value(entry, value)) {
+					fprintf(stderr, "btp_merge() Unable allocate memory!\n");
+					exit(EXIT_FAILURE);
+				}
+
+				if (dst->journal != NULL) {
+					btp_journal_append(dst->journal, BTP_JOURNAL_REPLACE, entry->key, value);
+				}
+				changes++;
+			}
+		}
+	}
+
+	free(entries_dst);
+	free(entries_src);
+
+	if (changes > 0) {
+		dst->generation = next_generation();
+	}
+
+	print_debug("btp_merge() Changes: %d num entries: %d\n", changes, dst->num_entries);
+	return changes;
+}
+
+/***************************************************************************
+ * The function is a callback handler for the twalk function. It adds the
+ * memory of a node and its entry to the stored memory usage.
+ **************************************************************************/
+
+static void memory_counter(const void *nodep, const VISIT which, const int depth) {
+
+	if (which == leaf || which == preorder) {
+		const Entry *entry = *(const Entry **) nodep;
+		const size_t key_size = entry->key_len + 1;
+		const size_t value_size = strlen(entry->value) + 1;
+		const bool is_inline = entry->value == entry_inline_value(entry);
+
+		stored_memory->nodes += NODE_SIZE;
+		stored_memory->keys += key_size;
+		stored_memory->values += value_size;
+
+		//
+		// the entry block contains the struct, the key and the inline buffer
+		//
+		stored_memory->overhead += entry_size(entry) - key_size;
+
+		if (is_inline) {
+			stored_memory->overhead -= value_size;
+		} else {
+			stored_memory->overhead += malloc_usable_size(entry->value) - value_size;
+		}
+	}
+}
+
+/***************************************************************************
+ * The function returns the memory, which is used by the context.
+ **************************************************************************/
+
+BTP_memory btp_memory_usage(const BTP_ctx *ctx) {
+	BTP_memory memory = { 0, 0, 0, malloc_usable_size((void *) ctx), 0 };
+
+	stored_memory = &memory;
+	twalk(ctx->root, memory_counter);
+	stored_memory = NULL;
+
+	//
+	// a running compaction holds the entry array and the retired entries
+	//
+	if (ctx->compaction != NULL) {
+		memory.overhead += malloc_usable_size(ctx->compaction) + malloc_usable_size(ctx->compaction->entries);
+
+		for (Entry *entry = ctx->compaction->retired; entry != NULL; entry = (Entry *) entry->value) {
+			memory.overhead += entry_size(entry);
+		}
+	}
+
+	//
+	// the headers, the unused and the freed bytes of the blocks of the arena
+	//
+	if (ctx->arena != NULL) {
+		memory.overhead += malloc_usable_size(ctx->arena);
+
+		for (const Slab *slab = ctx->arena->slabs; slab != NULL; slab = slab->next) {
+			memory.overhead += SLAB_SIZE - slab->used;
+		}
+	}
+
+	memory.total = memory.nodes + memory.keys + memory.values + memory.overhead;
+
+	print_debug("btp_memory_usage() nodes: %zu keys: %zu values: %zu overhead: %zu total: %zu\n", memory.nodes, memory.keys, memory.values, memory.overhead, memory.total);
+	return memory;
+}
+
+/***************************************************************************
+ * The function compacts a context in bounded steps. Each step moves one
+ * entry with its key and value to the arena of the context and exchanges
+ * it in its node. The entries of a compaction fill new blocks of the arena
+ * in sorted order, so they are densely packed, and the blocks of the old
+ * entries are freed. The nodes are owned by tsearch and are kept, so a
+ * step cannot fail after the entry is allocated. The first call collects
+ * the entry pointers once. A call does at most max_steps steps, or all if
+ * max_steps is not positive, and each step costs a single tfind. Entries
+ * that were removed since the start are skipped. The function returns
+ * true if the compaction is finished.
+ **************************************************************************/
+
+bool btp_compact(BTP_ctx *ctx, const int max_steps) {
+	BTP_compaction *compaction = ctx->compaction;
+
+	if (ctx->arena == NULL) {
+		ctx->arena = calloc(1, sizeof(BTP_arena));
+
+		if (ctx->arena == NULL) {
+			fprintf(stderr, "btp_compact() Unable allocate memory!\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (compaction == NULL) {
+		compaction = calloc(1, sizeof(BTP_compaction));
+
+		if (compaction == NULL) {
+			fprintf(stderr, "btp_compact() Unable allocate memory!\n");
 			exit(EXIT_FAILURE);
 		}
 
+		compaction->entries = collect_entries(ctx);
+		compaction->num_entries = ctx->num_entries;
+		ctx->compaction = compaction;
+	}
+
+	int steps = 0;
+	int moved = 0;
+
+	while (compaction->idx < compaction->num_entries && (max_steps <= 0 || steps < max_steps)) {
+		Entry *old_entry = (Entry *) compaction->entries[compaction->idx++];
+		steps++;
+
+		//
+		// the entry was removed from the context after the start
+		//
+		if (old_entry->key == NULL) {
+			continue;
+		}
+
+		Entry *new_entry = arena_create_entry(ctx->arena, old_entry->key, old_entry->value);
+
+		if (new_entry == NULL) {
+			fprintf(stderr, "btp_compact() Unable allocate memory!\n");
+			exit(EXIT_FAILURE);
+		}
+
+		Entry **node = (Entry **) tfind(old_entry, &(ctx->root), compare_entries);
+		*node = new_entry;
+		delete_entry(old_entry);
+		moved++;
+	}
+
+	print_debug("btp_compact() Steps: %d moved: %d compacted: %d of: %d\n", steps, moved, compaction->idx, compaction->num_entries);
+
+	//
+	// the entries were reallocated, so the generation changes
+	//
+	if (moved > 0) {
+		ctx->generation = next_generation();
+	}
+
+	if (compaction->idx == compaction->num_entries) {
+		free_compaction(ctx);
+		return true;
+	}
+
+	return false;
+}
+
+/***************************************************************************
+ * The function is used by tdestroy for a tree, whose entries are owned by
+ * another tree.
+ **************************************************************************/
+
+static void keep_entry(void *ptr) {
+}
+
+/***************************************************************************
+ * The function splits a line into the key and the value. Leading and
+ * tailing whitespaces are removed. For empty lines and comments the key is
+ * set to NULL. The function returns false, if the line does not contain a
+ * '=' delimiter.
+ **************************************************************************/
+
+static bool split_line(char *raw_line, char **key, char **value) {
+	char *line = trim(raw_line);
+
+	*key = NULL;
+	*value = NULL;
+
+	//
+	// skip empty lines or comments
+	//
+	if (!*line || *line == '#') {
+		return true;
+	}
+
+	//
+	// search = as a key / value delimiter
+	//
+	char *idx = index(line, '=');
+	if (!idx) {
+		return false;
+	}
+
+	//
+	// split line by = and get key and value
+	//
+	(*idx) = '\0';
+	*key = r_trim(line);
+	*value = l_trim(idx + 1);
+
+	print_debug("split_line() key: '%s' value: '%s'\n", *key, *value);
+	return true;
+}
+
+/***************************************************************************
+ * The function parses a line with a key value pair and adds it to the
+ * context. The value of an existing key is replaced. Empty lines and
+ * comments are ignored. The line is modified. The function returns false
+ * and fills the error report, if the line is not valid or the property
+ * cannot be added.
+ **************************************************************************/
+
+bool btp_try_parse_property(BTP_ctx *ctx, char *line, BTP_error *error) {
+	char *key;
+	char *value;
+
+	if (line == NULL) {
+		return set_error(error, BTP_ERROR_ARGUMENT, NULL, 0, "Line is NULL");
+	}
+
+	if (!split_line(line, &key, &value)) {
+		return set_error(error, BTP_ERROR_SYNTAX, NULL, 0, "Line does not contain '='");
+	}
+
+	if (key == NULL) {
+		return true;
+	}
+
+	return btp_try_add_property(ctx, key, value, true, NULL, error);
+}
+
+/***************************************************************************
+ * The function moves the entries of the staging context to the context.
+ * First the new keys are inserted. If this fails, the inserted keys are
+ * removed again, so the context is unchanged. Then the entries of the
+ * existing keys are exchanged in their nodes, which cannot fail. The
+ * staging context is empty afterwards.
+ **************************************************************************/
+
+static bool commit_staging(BTP_ctx *ctx, BTP_ctx *staging, const char *filename, BTP_error *error) {
+	const int num = staging->num_entries;
+	const Entry **entries = malloc((num + 1) * sizeof(Entry *));
+	bool *is_new = malloc((num + 1) * sizeof(bool));
+
+	if (entries == NULL || is_new == NULL) {
+		free(entries);
+		free(is_new);
+		return set_error(error, BTP_ERROR_MEMORY, filename, 0, "Unable allocate memory");
+	}
+
+	fill_entries(staging, entries);
+
+	//
+	// insert the new keys
+	//
+	for (int i = 0; i < num; i++) {
+		is_new[i] = tfind(entries[i], &(ctx->root), compare_entries) == NULL;
+
+		if (is_new[i] && tsearch((void *) entries[i], &(ctx->root), compare_entries) == NULL) {
+
+			for (int j = 0; j < i; j++) {
+				if (is_new[j]) {
+					tdelete(entries[j], &(ctx->root), compare_entries);
+				}
+			}
+
+			free(entries);
+			free(is_new);
+			return set_error(error, BTP_ERROR_MEMORY, filename, 0, "Unable allocate memory");
+		}
+	}
+
+	//
+	// exchange the entries of the existing keys
+	//
+	for (int i = 0; i < num; i++) {
+		Entry *entry = (Entry *) entries[i];
+
+		if (is_new[i]) {
+			ctx->num_entries++;
+
+			if (ctx->journal != NULL) {
+				btp_journal_append(ctx->journal, BTP_JOURNAL_ADD, entry->key, entry->value);
+			}
+			continue;
+		}
+
+		Entry **node = (Entry **) tfind(entry, &(ctx->root), compare_entries);
+		Entry *old_entry = *node;
+		*node = entry;
+		release_entry(ctx, old_entry);
+
+		if (ctx->journal != NULL) {
+			btp_journal_append(ctx->journal, BTP_JOURNAL_REPLACE, entry->key, entry->value);
+		}
+	}
+
+	if (num > 0) {
+		ctx->generation = next_generation();
+	}
+
+	//
+	// the entries are owned by the context now
+	//
+	tdestroy(staging->root, keep_entry);
+	staging->root = NULL;
+	staging->num_entries = 0;
+
+	free(entries);
+	free(is_new);
+
+	print_debug("commit_staging() Committed entries: %d num entries: %d\n", num, ctx->num_entries);
+	return true;
+}
+
+/***************************************************************************
+ * The function reads a line into the buffer, which has space for the line
+ * and the '\0'. Every byte that is read is counted against the file size
+ * limit, whatever the type of the file. A line is not read further than
+ * the line length limit and a line that contains a '\0' is rejected, so
+ * the time and memory are bounded for untrusted input. The function
+ * returns 1 for a line, 0 at the end of the file and -1 on an error.
+ **************************************************************************/
+
+static int read_line(FILE *file, char *buffer, const int max_line_len, const long max_file_size, long *file_size, const char *filename, const int line_no, BTP_error *error) {
+	int len = 0;
+	int c;
+
+	while ((c = getc(file)) != EOF) {
+		(*file_size)++;
+
+		if (max_file_size > 0 && *file_size > max_file_size) {
+			set_error(error, BTP_ERROR_FILE_SIZE, filename, line_no, "File size exceeds limit: %ld", max_file_size);
+			return -1;
+		}
+
+		if (c == '\n') {
+			break;
+		}
+
+		if (c == '\0') {
+			set_error(error, BTP_ERROR_SYNTAX, filename, line_no, "Line contains '\\0'");
+			return -1;
+		}
+
+		if (len == max_line_len) {
+			set_error(error, BTP_ERROR_LINE_LENGTH, filename, line_no, "Line exceeds limit: %d", max_line_len);
+			return -1;
+		}
+
+		buffer[len++] = c;
+	}
+
+	if (c == EOF && ferror(file)) {
+		set_error(error, BTP_ERROR_READ, filename, line_no, "Unable to read file: %s", strerror(errno));
+		return -1;
+	}
+
+	buffer[len] = '\0';
+
+	return c == EOF && len == 0 ? 0 : 1;
+}
+
+/***************************************************************************
+ * The method reads the properties from a configuration file. The file is
+ * parsed into a staging context, which is moved to the context, if the
+ * whole file is valid. On failure, the function returns false, fills the
+ * error report with the file, the line and the reason and leaves the
+ * context unchanged. The limits bound the size of the file, the length of
+ * a line and the number of keys. A limit of 0 is unlimited, except for the
+ * line length, where 0 is the default MAX_LINE. The limits may be NULL.
+ **************************************************************************/
+
+bool btp_try_read_properties(BTP_ctx *ctx, const char *filename, const BTP_limits *limits, BTP_error *error) {
+	const BTP_limits no_limits = { 0, 0, 0 };
+	BTP_ctx staging = { NULL, 0, next_generation(), NULL, NULL, NULL };
+	FILE *file;
+	char *raw_line;
+	char *key;
+	char *value;
+	int line_no = 0;
+	long file_size = 0;
+	bool result = true;
+
+	if (limits == NULL) {
+		limits = &no_limits;
+	}
+
+	const int max_line_len = limits->max_line_len > 0 ? limits->max_line_len : MAX_LINE;
+
+	print_debug("btp_try_read_properties() Opening file: '%s'\n", filename);
+
+	file = fopen(filename, "r");
+	if (file == NULL) {
+		return set_error(error, BTP_ERROR_OPEN, filename, 0, "Unable to open file: %s", strerror(errno));
+	}
+
+	//
+	// check the size of a regular file before reading it
+	//
+	struct stat st;
+	if (limits->max_file_size > 0 && fstat(fileno(file), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > limits->max_file_size) {
+		fclose(file);
+		return set_error(error, BTP_ERROR_FILE_SIZE, filename, 0, "File size: %lld exceeds limit: %ld", (long long) st.st_size, limits->max_file_size);
+	}
+
+	//
+	// the buffer contains the line and the '\0'
+	//
+	raw_line = malloc(max_line_len + 1);
+	if (raw_line == NULL) {
+		fclose(file);
+		return set_error(error, BTP_ERROR_MEMORY, filename, 0, "Unable allocate memory");
+	}
+
+	while (result) {
+		const int status = read_line(file, raw_line, max_line_len, limits->max_file_size, &file_size, filename, line_no + 1, error);
+
+		if (status <= 0) {
+			result = status == 0;
+			break;
+		}
+		line_no++;
+
+		if (!split_line(raw_line, &key, &value)) {
+			result = set_error(error, BTP_ERROR_SYNTAX, filename, line_no, "Line does not contain '='");
+			break;
+		}
+
+		if (key == NULL) {
+			continue;
+		}
+
 		//
-		// split line by = and get key and value
+		// keep the reason of the error and add the file and the line
 		//
-		(*idx) = '\0';
-		key = r_trim(line);
-		value = l_trim(idx + 1);
-		print_debug("btp_read_properties() key: '%s' value: '%s'\n", key, value);
-		btp_add_property(ctx, key, value, true);
+		if (!btp_try_add_property(&staging, key, value, true, NULL, error)) {
+			if (error != NULL) {
+				error->file = filename;
+				error->line = line_no;
+			}
+			result = false;
+			break;
+		}
+
+		if (limits->max_keys > 0 && staging.num_entries > limits->max_keys) {
+			result = set_error(error, BTP_ERROR_NUM_KEYS, filename, line_no, "Number of keys exceeds limit: %d", limits->max_keys);
+			break;
+		}
 	}
 
 	fclose(file);
-	return;
+	free(raw_line);
+
+	if (result) {
+		result = commit_staging(ctx, &staging, filename, error);
+	}
+
+	tdestroy(staging.root, delete_entry);
+
+	print_debug("btp_try_read_properties() File: '%s' result: %d num entries: %d\n", filename, result, ctx->num_entries);
+	return result;
 }
 
+/***************************************************************************
+ * The method reads the properties from a configuration file.
+ **************************************************************************/
+
+void btp_read_properties(BTP_ctx *ctx, const char *filename) {
+	BTP_error error;
+
+	if (!btp_try_read_properties(ctx, filename, NULL, &error)) {
+		fprintf(stderr, "btp_read_properties() File: '%s' line: %d %s!\n", filename, error.line, error.reason);
+		exit(EXIT_FAILURE);
+	}
+}
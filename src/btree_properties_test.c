@@ -8,8 +8,12 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "btree_properties.h"
+#include "btree_journal.h"
+#include "btree_static.h"
+#include "test_props.h"
 
 #define MAX_KEY_VALUE 32
 
@@ -18,6 +22,23 @@
 //
 #define TEST_1_PROPS "resources/test-1.props"
 #define TEST_2_PROPS "resources/test-2.props"
+#define TEST_3_PROPS "resources/test-3.props"
+#define TEST_4_PROPS "resources/test-4.props"
+#define TEST_MISSING_PROPS "resources/missing.props"
+
+//
+// Definition of the journal files of the tests
+//
+#define TEST_JOURNAL "/tmp/btree_properties_test.journal"
+#define TEST_JOURNAL_BASE TEST_JOURNAL ".base"
+#define TEST_JOURNAL_PREV TEST_JOURNAL ".prev"
+
+//
+// The number of entries of the locality test and the maximum size of an
+// entry with the key "key-0000" and the value "value-0000".
+//
+#define LOCALITY_ENTRIES 2000
+#define LOCALITY_ENTRY_SIZE 64
 
 /***************************************************************************
  * The function is a callback for the iterator function. It simply prints
@@ -254,6 +275,581 @@ void test_3() {
 	printf("Finished test 3\n");
 }
 
+/***************************************************************************
+ * The fourth test writes changes to a journal and replays them with a new
+ * context. The compact size is small, so the journal is compacted to a base
+ * file. A torn tail of the journal is ignored. At last, an interrupted
+ * compaction with a stale base file and a previous journal is finished.
+ **************************************************************************/
+
+void test_4() {
+	char key[MAX_KEY_VALUE];
+	char value[MAX_KEY_VALUE];
+
+	printf("Starting test 4\n");
+
+	unlink(TEST_JOURNAL);
+	unlink(TEST_JOURNAL_BASE);
+	unlink(TEST_JOURNAL_PREV);
+
+	BTP_ctx *ctx = btp_create_ctx();
+	btp_journal_open(ctx, TEST_JOURNAL, 4, 512);
+
+	//
+	// add 100 properties, replace the even and delete every third
+	//
+	for (int idx = 0; idx < 100; idx++) {
+		snprintf(key, MAX_KEY_VALUE, "key-%d", idx);
+		snprintf(value, MAX_KEY_VALUE, "value-%d", idx);
+		btp_add_property(ctx, key, value, false);
+	}
+
+	for (int idx = 0; idx < 100; idx += 2) {
+		snprintf(key, MAX_KEY_VALUE, "key-%d", idx);
+		snprintf(value, MAX_KEY_VALUE, "new-value-%d", idx);
+		btp_add_property(ctx, key, value, true);
+	}
+
+	for (int idx = 0; idx < 100; idx += 3) {
+		snprintf(key, MAX_KEY_VALUE, "key-%d", idx);
+		btp_delete_property(ctx, key);
+	}
+
+	ensure_int(66, btp_get_num_entries(ctx));
+
+	//
+	// replace a separately stored value with itself
+	//
+	btp_add_property(ctx, "key-1", "a-value-that-does-not-fit-in-the-inline-buffer", true);
+	btp_add_property(ctx, "key-1", btp_get_property_value(ctx, "key-1"), true);
+	btp_add_property(ctx, "key-1", "value-1", true);
+
+	//
+	// destroying the context closes and syncs the journal
+	//
+	btp_destroy_ctx(ctx);
+
+	ensure_bool(true, access(TEST_JOURNAL_BASE, F_OK) == 0);
+
+	//
+	// append a torn record to the journal
+	//
+	FILE *file = fopen(TEST_JOURNAL, "a");
+	fputs("A\x07", file);
+	fclose(file);
+
+	//
+	// replay the journal with a new context
+	//
+	for (int run = 0; run < 2; run++) {
+		ctx = btp_create_ctx();
+		btp_journal_open(ctx, TEST_JOURNAL, 0, 0);
+
+		ensure_int(66, btp_get_num_entries(ctx));
+
+		for (int idx = 0; idx < 100; idx++) {
+			snprintf(key, MAX_KEY_VALUE, "key-%d", idx);
+
+			if (idx % 3 == 0) {
+				ensure_bool(true, btp_get_property_value(ctx, key) == NULL);
+			} else if (idx % 2 == 0) {
+				ensure_indexed(ctx, "key-%d", "new-value-%d", idx, false);
+			} else {
+				ensure_indexed(ctx, "key-%d", "value-%d", idx, false);
+			}
+		}
+
+		btp_destroy_ctx(ctx);
+	}
+
+	//
+	// the base file becomes stale and the journal with further changes
+	// becomes the previous journal of an interrupted compaction
+	//
+	ctx = btp_create_ctx();
+	btp_journal_open(ctx, TEST_JOURNAL, 0, 0);
+	btp_add_property(ctx, "key-1", "prev-value-1", true);
+	btp_delete_property(ctx, "key-2");
+	btp_add_property(ctx, "key-100", "value-100", false);
+	btp_destroy_ctx(ctx);
+
+	ensure_bool(true, rename(TEST_JOURNAL, TEST_JOURNAL_PREV) == 0);
+
+	for (int run = 0; run < 2; run++) {
+		ctx = btp_create_ctx();
+		btp_journal_open(ctx, TEST_JOURNAL, 0, 0);
+
+		ensure_bool(false, access(TEST_JOURNAL_PREV, F_OK) == 0);
+		ensure_int(66, btp_get_num_entries(ctx));
+		ensure(ctx, "key-1", "prev-value-1");
+		ensure_bool(true, btp_get_property_value(ctx, "key-2") == NULL);
+		ensure(ctx, "key-4", "new-value-4");
+		ensure(ctx, "key-100", "value-100");
+
+		btp_destroy_ctx(ctx);
+	}
+
+	unlink(TEST_JOURNAL);
+	unlink(TEST_JOURNAL_BASE);
+	unlink(TEST_JOURNAL_PREV);
+
+	printf("Finished test 4\n");
+}
+
+/***************************************************************************
+ * The counters of the differences, which are updated by the diff callback.
+ **************************************************************************/
+
+static int num_added;
+static int num_removed;
+static int num_changed;
+
+/***************************************************************************
+ * The function is a callback for the diff function. It prints and counts
+ * the differences.
+ **************************************************************************/
+
+void count_diff(const BTP_diff_type type, const char *key, const char *value_a, const char *value_b) {
+	printf("Diff: %d key: '%s' value a: '%s' value b: '%s'\n", type, key, value_a, value_b);
+
+	switch (type) {
+	case BTP_DIFF_ADDED:
+		num_added++;
+		break;
+	case BTP_DIFF_REMOVED:
+		num_removed++;
+		break;
+	case BTP_DIFF_CHANGED:
+		num_changed++;
+		break;
+	}
+}
+
+/***************************************************************************
+ * The function resets the counters and calls the diff function.
+ **************************************************************************/
+
+void ensure_diff(BTP_ctx *ctx_a, BTP_ctx *ctx_b, const int added, const int removed, const int changed) {
+	num_added = 0;
+	num_removed = 0;
+	num_changed = 0;
+
+	btp_diff(ctx_a, ctx_b, count_diff);
+
+	ensure_int(added, num_added);
+	ensure_int(removed, num_removed);
+	ensure_int(changed, num_changed);
+}
+
+/***************************************************************************
+ * The fifth test compares and merges two contexts.
+ **************************************************************************/
+
+void test_5() {
+
+	printf("Starting test 5\n");
+
+	BTP_ctx *ctx_a = btp_create_ctx();
+	BTP_ctx *ctx_b = btp_create_ctx();
+
+	btp_add_property(ctx_a, "key-1", "value-1", false);
+	btp_add_property(ctx_a, "key-2", "value-2", false);
+	btp_add_property(ctx_a, "key-3", "value-3", false);
+	btp_add_property(ctx_a, "key-5", "value-5", false);
+
+	btp_add_property(ctx_b, "key-0", "value-0", false);
+	btp_add_property(ctx_b, "key-2", "value-2", false);
+	btp_add_property(ctx_b, "key-3", "new-value-3", false);
+	btp_add_property(ctx_b, "key-4", "value-4", false);
+
+	//
+	// key-0 and key-4 are added, key-1 and key-5 removed and key-3 changed
+	//
+	ensure_diff(ctx_a, ctx_b, 2, 2, 1);
+	ensure_diff(ctx_b, ctx_a, 2, 2, 1);
+	ensure_diff(ctx_a, ctx_a, 0, 0, 0);
+
+	//
+	// keep adds the missing keys only
+	//
+	ensure_int(2, btp_merge(ctx_a, ctx_b, BTP_MERGE_KEEP));
+	ensure_int(6, btp_get_num_entries(ctx_a));
+	ensure(ctx_a, "key-0", "value-0");
+	ensure(ctx_a, "key-3", "value-3");
+	ensure_diff(ctx_a, ctx_b, 0, 2, 1);
+
+	//
+	// replace takes the values of the source
+	//
+	ensure_int(1, btp_merge(ctx_a, ctx_b, BTP_MERGE_REPLACE));
+	ensure(ctx_a, "key-3", "new-value-3");
+	ensure_diff(ctx_a, ctx_b, 0, 2, 0);
+
+	//
+	// mirror removes the keys, which are not in the source
+	//
+	ensure_int(2, btp_merge(ctx_a, ctx_b, BTP_MERGE_MIRROR));
+	ensure_int(4, btp_get_num_entries(ctx_a));
+	ensure_diff(ctx_a, ctx_b, 0, 0, 0);
+
+	btp_destroy_ctx(ctx_a);
+	btp_destroy_ctx(ctx_b);
+
+	printf("Finished test 5\n");
+}
+
+/***************************************************************************
+ * The function returns the number of entries, whose inline value follows
+ * the value of the previous key within the size of an entry. These entries
+ * are adjacent in the memory.
+ **************************************************************************/
+
+int count_adjacent(BTP_ctx *ctx) {
+	char key[MAX_KEY_VALUE];
+	const char *prev = NULL;
+	int adjacent = 0;
+
+	for (int idx = 0; idx < LOCALITY_ENTRIES; idx++) {
+		snprintf(key, MAX_KEY_VALUE, "key-%04d", idx);
+		const char *value = btp_get_property_value(ctx, key);
+
+		if (prev != NULL && value > prev && value - prev <= LOCALITY_ENTRY_SIZE) {
+			adjacent++;
+		}
+		prev = value;
+	}
+
+	printf("Adjacent entries: %d of: %d\n", adjacent, LOCALITY_ENTRIES);
+	return adjacent;
+}
+
+/***************************************************************************
+ * The sixth test checks the memory usage and compacts a context in bounded
+ * steps, while the context is changed between the steps. After that, the
+ * entries of a fragmented context are compacted, which packs them densely
+ * in the order of the keys.
+ **************************************************************************/
+
+void test_6() {
+	char key[MAX_KEY_VALUE];
+	char value[MAX_KEY_VALUE];
+	int steps = 0;
+
+	printf("Starting test 6\n");
+
+	BTP_ctx *ctx = btp_create_ctx();
+
+	//
+	// add 100 properties with keys of 6 or 7 bytes ("key-10") and replace
+	// the values with longer values
+	//
+	for (int idx = 10; idx < 110; idx++) {
+		snprintf(key, MAX_KEY_VALUE, "key-%d", idx);
+		snprintf(value, MAX_KEY_VALUE, "value-%d", idx);
+		btp_add_property(ctx, key, value, false);
+	}
+
+	for (int idx = 10; idx < 110; idx++) {
+		snprintf(key, MAX_KEY_VALUE, "key-%d", idx);
+		snprintf(value, MAX_KEY_VALUE, "replaced-value-%d", idx);
+		btp_add_property(ctx, key, value, true);
+	}
+
+	const BTP_memory before = btp_memory_usage(ctx);
+	ensure_int(90 * 7 + 10 * 8, before.keys);
+	ensure_int(90 * 18 + 10 * 19, before.values);
+
+	//
+	// compact in steps of 10 entries, with changes between the steps
+	//
+	while (!btp_compact(ctx, 10)) {
+		steps++;
+
+		//
+		// key-10 is already compacted, key-98 is not
+		//
+		if (steps == 2) {
+			btp_delete_property(ctx, "key-10");
+			btp_delete_property(ctx, "key-98");
+			btp_add_property(ctx, "key-99", "other-value-99", true);
+		}
+	}
+
+	ensure_int(9, steps);
+	ensure_int(98, btp_get_num_entries(ctx));
+	ensure(ctx, "key-99", "other-value-99");
+	ensure_bool(true, btp_get_property_value(ctx, "key-98") == NULL);
+
+	for (int idx = 11; idx < 98; idx++) {
+		ensure_indexed(ctx, "key-%d", "replaced-value-%d", idx, false);
+	}
+
+	//
+	// the values are inline after the compaction, so the overhead is smaller
+	//
+	const BTP_memory after = btp_memory_usage(ctx);
+	ensure_int(before.keys - 7 - 7, after.keys);
+	ensure_bool(true, after.overhead < before.overhead);
+	ensure_bool(true, after.total < before.total);
+
+	btp_destroy_ctx(ctx);
+
+	//
+	// the entries are interleaved with other allocations, which are freed
+	//
+	void *fillers[LOCALITY_ENTRIES];
+	ctx = btp_create_ctx();
+
+	for (int idx = 0; idx < LOCALITY_ENTRIES; idx++) {
+		snprintf(key, MAX_KEY_VALUE, "key-%04d", idx);
+		snprintf(value, MAX_KEY_VALUE, "value-%04d", idx);
+		btp_add_property(ctx, key, value, false);
+		fillers[idx] = malloc(LOCALITY_ENTRY_SIZE - 16);
+	}
+
+	for (int idx = 0; idx < LOCALITY_ENTRIES; idx++) {
+		free(fillers[idx]);
+	}
+
+	ensure_bool(true, count_adjacent(ctx) < LOCALITY_ENTRIES / 2);
+
+	//
+	// the compacted entries are adjacent, except at the ends of the blocks,
+	// and a second compaction frees the blocks of the first
+	//
+	ensure_bool(true, btp_compact(ctx, 0));
+	ensure_bool(true, count_adjacent(ctx) >= LOCALITY_ENTRIES - LOCALITY_ENTRIES / 20);
+	const BTP_memory packed = btp_memory_usage(ctx);
+
+	ensure_bool(true, btp_compact(ctx, 0));
+	ensure_bool(true, count_adjacent(ctx) >= LOCALITY_ENTRIES - LOCALITY_ENTRIES / 20);
+	ensure_int(packed.total, btp_memory_usage(ctx).total);
+
+	for (int idx = 0; idx < LOCALITY_ENTRIES; idx++) {
+		ensure_indexed(ctx, "key-%04d", "value-%04d", idx, false);
+	}
+
+	btp_destroy_ctx(ctx);
+
+	printf("Finished test 6\n");
+}
+
+/***************************************************************************
+ * The seventh test compares the static context, which is generated from
+ * the second properties file by the makefile, with the parsed file.
+ **************************************************************************/
+
+void test_7() {
+	char key[MAX_KEY_VALUE];
+
+	printf("Starting test 7\n");
+
+	BTP_ctx *ctx = btp_create_ctx();
+	btp_read_properties(ctx, TEST_2_PROPS);
+
+	ensure_int(btp_get_num_entries(ctx), btp_static_get_num_entries(&test_props));
+
+	for (int idx = 1; idx < 4; idx++) {
+		const char *formats[] = { "db.%d.db", "db.%d.user", "db.%d.password", "db.%d.connection" };
+
+		for (int i = 0; i < 4; i++) {
+			snprintf(key, MAX_KEY_VALUE, formats[i], idx);
+
+			const char *value = btp_static_get_property_value(&test_props, key);
+			ensure_bool(true, value != NULL);
+			ensure(ctx, key, (char *) value);
+		}
+	}
+
+	//
+	// unknown keys are not found
+	//
+	ensure_bool(true, btp_static_get_property_value(&test_props, "db.4.db") == NULL);
+	ensure_bool(true, btp_static_get_property_value(&test_props, "") == NULL);
+	ensure_bool(true, btp_static_get_property_value(&test_props, "db.1.db.x") == NULL);
+
+	btp_static_iterate_properties(&test_props, print_properties);
+
+	btp_destroy_ctx(ctx);
+
+	printf("Finished test 7\n");
+}
+
+/***************************************************************************
+ * The eighth test ensures that repeated lookups with the same key pointer
+ * are never stale, if the context or the content of the key changes.
+ **************************************************************************/
+
+void test_8() {
+	char key[MAX_KEY_VALUE];
+
+	printf("Starting test 8\n");
+
+	BTP_ctx *ctx = btp_create_ctx();
+	btp_add_property(ctx, "key-1", "value-1", false);
+	btp_add_property(ctx, "key-2", "value-2", false);
+
+	//
+	// repeated lookups with the same string literal
+	//
+	for (int i = 0; i < 3; i++) {
+		ensure(ctx, "key-1", "value-1");
+	}
+
+	//
+	// a cache hit does not search the btree, so it finds the value even if
+	// the root is hidden
+	//
+	void *root = ctx->root;
+	ctx->root = NULL;
+#ifdef BTP_LOOKUP_CACHE
+	ensure(ctx, "key-1", "value-1");
+#else
+	ensure_bool(true, btp_get_property_value(ctx, "key-1") == NULL);
+#endif
+	ctx->root = root;
+
+	//
+	// replace and delete change the generation of the context
+	//
+	btp_add_property(ctx, "key-1", "new-value-1", true);
+	ensure(ctx, "key-1", "new-value-1");
+
+	btp_delete_property(ctx, "key-1");
+	ensure_bool(true, btp_get_property_value(ctx, "key-1") == NULL);
+
+	//
+	// the same buffer with a different content
+	//
+	strcpy(key, "key-2");
+	ensure(ctx, key, "value-2");
+	strcpy(key, "key-3");
+	ensure_bool(true, btp_get_property_value(ctx, key) == NULL);
+
+	//
+	// a new context at the same address does not use the old cache lines
+	//
+	btp_destroy_ctx(ctx);
+	ctx = btp_create_ctx();
+	btp_add_property(ctx, "key-2", "other-value-2", false);
+	ensure(ctx, "key-2", "other-value-2");
+	ensure_bool(true, btp_get_property_value(ctx, "key-1") == NULL);
+
+	btp_destroy_ctx(ctx);
+
+	printf("Finished test 8\n");
+}
+
+/***************************************************************************
+ * The method ensures that reading a file fails with the expected error
+ * code and line and that the context is unchanged.
+ **************************************************************************/
+
+void ensure_read_error(BTP_ctx *ctx, const char *filename, const BTP_limits *limits, const BTP_error_code code, const int line) {
+	BTP_error error;
+	const int num_entries = btp_get_num_entries(ctx);
+
+	ensure_bool(false, btp_try_read_properties(ctx, filename, limits, &error));
+	printf("Error file: '%s' line: %d reason: %s\n", error.file, error.line, error.reason);
+
+	ensure_int(code, error.code);
+	ensure_int(line, error.line);
+	ensure_int(num_entries, btp_get_num_entries(ctx));
+	ensure(ctx, "key-1", "value-1");
+}
+
+/***************************************************************************
+ * The ninth test checks the functions, which report errors instead of
+ * exiting, and the limits for reading files.
+ **************************************************************************/
+
+void test_9() {
+	BTP_error error;
+	BTP_limits limits;
+	bool added;
+	char line[MAX_KEY_VALUE];
+
+	printf("Starting test 9\n");
+
+	BTP_ctx *ctx = btp_create_ctx();
+	ensure_bool(true, btp_try_read_properties(ctx, TEST_1_PROPS, NULL, &error));
+	ensure_int(4, btp_get_num_entries(ctx));
+
+	//
+	// a file with a missing '=' in line 5 and a missing file
+	//
+	ensure_read_error(ctx, TEST_3_PROPS, NULL, BTP_ERROR_SYNTAX, 5);
+	ensure_bool(true, btp_get_property_value(ctx, "key-5") == NULL);
+	ensure_read_error(ctx, TEST_MISSING_PROPS, NULL, BTP_ERROR_OPEN, 0);
+
+	//
+	// a line with a '\0' and a device without lines are rejected
+	//
+	ensure_read_error(ctx, TEST_4_PROPS, NULL, BTP_ERROR_SYNTAX, 2);
+	ensure_bool(true, btp_get_property_value(ctx, "a") == NULL);
+	ensure_read_error(ctx, "/dev/zero", NULL, BTP_ERROR_SYNTAX, 1);
+
+	//
+	// the limits for the number of keys, the line length and the file size
+	//
+	limits = (BTP_limits) { 0, 0, 3 };
+	ensure_read_error(ctx, TEST_1_PROPS, &limits, BTP_ERROR_NUM_KEYS, 14);
+
+	limits = (BTP_limits) { 0, 30, 0 };
+	ensure_read_error(ctx, TEST_1_PROPS, &limits, BTP_ERROR_LINE_LENGTH, 8);
+
+	limits = (BTP_limits) { 64, 0, 0 };
+	ensure_read_error(ctx, TEST_1_PROPS, &limits, BTP_ERROR_FILE_SIZE, 0);
+
+	//
+	// the size of a file in /proc is 0, so the bytes have to be counted
+	//
+	limits = (BTP_limits) { 16, 0, 0 };
+	ensure_read_error(ctx, "/proc/self/maps", &limits, BTP_ERROR_FILE_SIZE, 1);
+
+	limits = (BTP_limits) { 4096, 64, 4 };
+	ensure_bool(true, btp_try_read_properties(ctx, TEST_1_PROPS, &limits, &error));
+	ensure_int(4, btp_get_num_entries(ctx));
+	ensure(ctx, "key-4", "value-4");
+
+	//
+	// adding NULL values fails
+	//
+	ensure_bool(false, btp_try_add_property(ctx, "key-5", NULL, false, &added, &error));
+	ensure_int(BTP_ERROR_ARGUMENT, error.code);
+	ensure_bool(true, btp_try_add_property(ctx, "key-5", "value-5", false, &added, &error));
+	ensure_bool(true, added);
+
+	//
+	// parse single lines
+	//
+	strcpy(line, "  key-6 = value-6 ");
+	ensure_bool(true, btp_try_parse_property(ctx, line, &error));
+	ensure(ctx, "key-6", "value-6");
+
+	strcpy(line, "# comment");
+	ensure_bool(true, btp_try_parse_property(ctx, line, &error));
+
+	strcpy(line, "key-7");
+	ensure_bool(false, btp_try_parse_property(ctx, line, &error));
+	ensure_int(BTP_ERROR_SYNTAX, error.code);
+
+	ensure_int(6, btp_get_num_entries(ctx));
+
+	//
+	// NULL keys are rejected
+	//
+	ensure_bool(true, btp_get_property_value(ctx, NULL) == NULL);
+	ensure_bool(false, btp_delete_property(ctx, NULL));
+	ensure_bool(false, btp_try_add_property(ctx, NULL, "value", false, &added, &error));
+	ensure_int(BTP_ERROR_ARGUMENT, error.code);
+	ensure_int(6, btp_get_num_entries(ctx));
+
+	btp_destroy_ctx(ctx);
+
+	printf("Finished test 9\n");
+}
+
 /***************************************************************************
  * The main function simply triggers the tests.
  **************************************************************************/
@@ -266,6 +862,18 @@ int main(int argc, char *argv[]) {
 
 	test_3();
 
+	test_4();
+
+	test_5();
+
+	test_6();
+
+	test_7();
+
+	test_8();
+
+	test_9();
+
 	printf("Tests successfully finished!");
 	return EXIT_SUCCESS;
 }
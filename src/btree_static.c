@@ -0,0 +1,84 @@
+/***************************************************************************
+ * btree_static.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Dead-End
+ **************************************************************************/
+
+#include <string.h>
+
+#include "btree_static.h"
+
+/***************************************************************************
+ * The function computes the FNV-1a hash of a key with a given seed. The
+ * result is mixed with the murmur3 finalizer, so hashes with different
+ * seeds are independent. The function is used by the generator and the
+ * lookup, so both have to use the same function.
+ **************************************************************************/
+
+uint32_t btp_static_hash(const uint32_t seed, const char *key, const size_t len) {
+	uint32_t hash = 2166136261u ^ seed;
+
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (unsigned char) key[i];
+		hash *= 16777619u;
+	}
+
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bu;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35u;
+	hash ^= hash >> 16;
+
+	return hash;
+}
+
+/***************************************************************************
+ * The method returns the number of entries.
+ **************************************************************************/
+
+int btp_static_get_num_entries(const BTP_static_ctx *ctx) {
+	return ctx->num_entries;
+}
+
+/***************************************************************************
+ * The method returns the value for a given key or null if it does not
+ * exist. The slot of the key is computed by the perfect hash, so only the
+ * key of this slot has to be compared.
+ **************************************************************************/
+
+const char *btp_static_get_property_value(const BTP_static_ctx *ctx, const char *key) {
+
+	if (ctx->num_entries == 0) {
+		return NULL;
+	}
+
+	const size_t len = strlen(key);
+	const uint32_t bucket = btp_static_hash(0, key, len) % ctx->num_entries;
+	const int32_t displacement = ctx->displacements[bucket];
+	uint32_t slot;
+
+	if (displacement < 0) {
+		slot = -displacement - 1;
+	} else {
+		slot = btp_static_hash(displacement, key, len) % ctx->num_entries;
+	}
+
+	if (ctx->key_lens[slot] != len || memcmp(ctx->pool + ctx->key_offsets[slot], key, len) != 0) {
+		return NULL;
+	}
+
+	return ctx->pool + ctx->value_offsets[slot];
+}
+
+/***************************************************************************
+ * The function calls the callback for each key / value pair in the order of
+ * the slots.
+ **************************************************************************/
+
+void btp_static_iterate_properties(const BTP_static_ctx *ctx, void (*callback)(const char *key, const char *value)) {
+
+	for (int slot = 0; slot < ctx->num_entries; slot++) {
+		callback(ctx->pool + ctx->key_offsets[slot], ctx->pool + ctx->value_offsets[slot]);
+	}
+}
@@ -31,7 +31,7 @@ char *r_trim(char *str) {
 	const int len = strlen(str);
 	char *c;
 
-	for (c = str + len - 1; isspace(*c); *(c--) = '\0')
+	for (c = str + len - 1; c >= str && isspace((unsigned char) *c); *(c--) = '\0')
 		;
 
 	return str;
@@ -44,7 +44,7 @@ char *r_trim(char *str) {
 char *l_trim(char *str) {
 	char *c;
 
-	for (c = str; isspace(*c); c++)
+	for (c = str; isspace((unsigned char) *c); c++)
 		;
 
 	return c;